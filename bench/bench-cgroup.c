@@ -0,0 +1,148 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "logind.h"
+#include "bench.h"
+
+/* Resolves deep container cgroup paths to their session and user,
+ * through the component tree and, for reference, through flat maps
+ * of full paths searched one parent directory at a time, the way
+ * logind used to */
+
+static const unsigned sizes[] = { 100, 10000, 100000 };
+
+static void flat_lookup(Hashmap *sessions, Hashmap *users, const char *cgroup, Session **session, User **user) {
+        char *p, *e;
+
+        p = strdupa(cgroup);
+
+        *session = NULL;
+        *user = NULL;
+
+        for (;;) {
+                if (!*session)
+                        *session = hashmap_get(sessions, p);
+                if (!*user)
+                        *user = hashmap_get(users, p);
+
+                if (*session && *user)
+                        return;
+
+                e = strrchr(p, '/');
+                if (!e || e == p)
+                        return;
+
+                *e = 0;
+        }
+}
+
+static void bench_one(unsigned n) {
+        BenchTimer tree = {}, flat = {};
+        Hashmap *sessions, *users;
+        char **session_paths, **user_paths, **lookup_paths;
+        Manager *m;
+        unsigned r, rounds, i;
+        char name[64];
+
+        m = new0(Manager, 1);
+        sessions = hashmap_new(string_hash_func, string_compare_func);
+        users = hashmap_new(string_hash_func, string_compare_func);
+        session_paths = new(char*, n);
+        user_paths = new(char*, n);
+        lookup_paths = new(char*, n);
+        assert_se(m && sessions && users && session_paths && user_paths && lookup_paths);
+
+        for (i = 0; i < n; i++) {
+                Session *s = UINT_TO_PTR(i + 1);
+                User *u = UINT_TO_PTR(i / 4 + 1);
+
+                assert_se(asprintf(&user_paths[i], "/machine/lxc-%u.libvirt-lxc/user/%u.user", i / 64, 1000 + i / 4) >= 0);
+                assert_se(asprintf(&session_paths[i], "%s/c%u.session", user_paths[i], i + 1) >= 0);
+                assert_se(asprintf(&lookup_paths[i], "%s/system/getty@tty%u.service/control", session_paths[i], i % 6 + 1) >= 0);
+
+                assert_se(manager_cgroup_map_session(m, session_paths[i], s) >= 0);
+                assert_se(manager_cgroup_map_user(m, user_paths[i], u) >= 0);
+                assert_se(hashmap_put(sessions, session_paths[i], s) >= 0);
+                assert_se(hashmap_replace(users, user_paths[i], u) >= 0);
+        }
+
+        rounds = bench_rounds(n);
+
+        for (r = 0; r < rounds; r++) {
+                Session *s;
+                User *u;
+
+                bench_timer_start(&tree);
+                for (i = 0; i < n; i++) {
+                        manager_cgroup_lookup(m, lookup_paths[i], &s, &u);
+                        bench_sink += (uintptr_t) s + (uintptr_t) u;
+                }
+                bench_timer_stop(&tree, n);
+
+                bench_timer_start(&flat);
+                for (i = 0; i < n; i++) {
+                        flat_lookup(sessions, users, lookup_paths[i], &s, &u);
+                        bench_sink += (uintptr_t) s + (uintptr_t) u;
+                }
+                bench_timer_stop(&flat, n);
+        }
+
+        snprintf(name, sizeof(name), "cgroup lookup tree n=%u", n);
+        bench_timer_report(&tree, name);
+        snprintf(name, sizeof(name), "cgroup lookup per-level n=%u", n);
+        bench_timer_report(&flat, name);
+
+        for (i = 0; i < n; i++) {
+                manager_cgroup_unmap_session(m, session_paths[i], UINT_TO_PTR(i + 1));
+                manager_cgroup_unmap_user(m, user_paths[i], UINT_TO_PTR(i / 4 + 1));
+        }
+        assert_se(!m->cgroup_root || hashmap_isempty(m->cgroup_root->children));
+        cgroup_node_free(m->cgroup_root);
+
+        hashmap_free(sessions);
+        hashmap_free(users);
+
+        for (i = 0; i < n; i++) {
+                free(session_paths[i]);
+                free(user_paths[i]);
+                free(lookup_paths[i]);
+        }
+
+        free(session_paths);
+        free(user_paths);
+        free(lookup_paths);
+        free(m);
+}
+
+int main(int argc, char *argv[]) {
+        unsigned i;
+
+        hashmap_randomize_hash_key();
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++)
+                bench_one(sizes[i]);
+
+        return 0;
+}
@@ -0,0 +1,133 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+#include <dbus/dbus.h>
+
+#include "util.h"
+#include "logind-method.h"
+#include "bench.h"
+
+/* Cost of finding the handler of a method call on the manager object,
+ * the old chain of dbus_message_is_method_call() against the table
+ * lookup, for a method early, in the middle and late in the chain */
+
+#define N_OPS 200000U
+
+static const struct {
+        const char *interface;
+        const char *member;
+} manager_methods[] = {
+        { "org.freedesktop.login1.Manager", "GetSession" },
+        { "org.freedesktop.login1.Manager", "GetSessionByPID" },
+        { "org.freedesktop.login1.Manager", "GetUser" },
+        { "org.freedesktop.login1.Manager", "GetSeat" },
+        { "org.freedesktop.login1.Manager", "ListSessions" },
+        { "org.freedesktop.login1.Manager", "ListUsers" },
+        { "org.freedesktop.login1.Manager", "ListSeats" },
+        { "org.freedesktop.login1.Manager", "ListInhibitors" },
+        { "org.freedesktop.login1.Manager", "ListSessionsEx" },
+        { "org.freedesktop.login1.Manager", "ListUsersEx" },
+        { "org.freedesktop.login1.Manager", "ListSeatsEx" },
+        { "org.freedesktop.login1.Manager", "ListInhibitorsEx" },
+        { "org.freedesktop.login1.Manager", "GetObjectProperties" },
+        { "org.freedesktop.login1.Manager", "Inhibit" },
+        { "org.freedesktop.login1.Manager", "CreateSession" },
+        { "org.freedesktop.login1.Manager", "ReleaseSession" },
+        { "org.freedesktop.login1.Manager", "ActivateSession" },
+        { "org.freedesktop.login1.Manager", "ActivateSessionOnSeat" },
+        { "org.freedesktop.login1.Manager", "LockSession" },
+        { "org.freedesktop.login1.Manager", "UnlockSession" },
+        { "org.freedesktop.login1.Manager", "LockSessions" },
+        { "org.freedesktop.login1.Manager", "UnlockSessions" },
+        { "org.freedesktop.login1.Manager", "KillSession" },
+        { "org.freedesktop.login1.Manager", "KillUser" },
+        { "org.freedesktop.login1.Manager", "TerminateSession" },
+        { "org.freedesktop.login1.Manager", "TerminateUser" },
+        { "org.freedesktop.login1.Manager", "TerminateSeat" },
+        { "org.freedesktop.login1.Manager", "SetUserLinger" },
+        { "org.freedesktop.login1.Manager", "AttachDevice" },
+        { "org.freedesktop.login1.Manager", "FlushDevices" },
+        { "org.freedesktop.login1.Manager", "PowerOff" },
+        { "org.freedesktop.login1.Manager", "Reboot" },
+        { "org.freedesktop.login1.Manager", "Suspend" },
+        { "org.freedesktop.login1.Manager", "Hibernate" },
+        { "org.freedesktop.login1.Manager", "HybridSleep" },
+        { "org.freedesktop.login1.Manager", "CanPowerOff" },
+        { "org.freedesktop.login1.Manager", "CanReboot" },
+        { "org.freedesktop.login1.Manager", "CanSuspend" },
+        { "org.freedesktop.login1.Manager", "CanHibernate" },
+        { "org.freedesktop.login1.Manager", "CanHybridSleep" },
+        { "org.freedesktop.login1.Stats", "GetStats" },
+        { "org.freedesktop.login1.Stats", "ResetStats" },
+        { "org.freedesktop.DBus.Introspectable", "Introspect" },
+};
+
+static int chain_lookup(DBusMessage *m) {
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(manager_methods); i++)
+                if (dbus_message_is_method_call(m, manager_methods[i].interface, manager_methods[i].member))
+                        return i;
+
+        return -1;
+}
+
+static void bench_one(unsigned idx) {
+        BenchTimer chain = {}, table = {};
+        DBusMessage *m;
+        unsigned r, rounds, k;
+        char name[64];
+
+        m = dbus_message_new_method_call("org.freedesktop.login1", "/org/freedesktop/login1",
+                                         manager_methods[idx].interface, manager_methods[idx].member);
+        assert_se(m);
+
+        assert_se(chain_lookup(m) == (int) idx);
+        assert_se(logind_method_from_message(m, LOGIND_OBJECT_MANAGER) == (int) idx);
+
+        rounds = bench_rounds(N_OPS);
+
+        for (r = 0; r < rounds; r++) {
+                bench_timer_start(&chain);
+                for (k = 0; k < N_OPS; k++)
+                        bench_sink += chain_lookup(m);
+                bench_timer_stop(&chain, N_OPS);
+
+                bench_timer_start(&table);
+                for (k = 0; k < N_OPS; k++)
+                        bench_sink += logind_method_from_message(m, LOGIND_OBJECT_MANAGER);
+                bench_timer_stop(&table, N_OPS);
+        }
+
+        snprintf(name, sizeof(name), "dispatch chain %s", manager_methods[idx].member);
+        bench_timer_report(&chain, name);
+        snprintf(name, sizeof(name), "dispatch table %s", manager_methods[idx].member);
+        bench_timer_report(&table, name);
+
+        dbus_message_unref(m);
+}
+
+int main(int argc, char *argv[]) {
+        bench_one(0);
+        bench_one(ELEMENTSOF(manager_methods) / 2);
+        bench_one(ELEMENTSOF(manager_methods) - 1);
+
+        return 0;
+}
@@ -0,0 +1,365 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "util.h"
+#include "logind.h"
+#include "bench.h"
+
+/* How long a CreateSession() call waits for dispatch while the udev
+ * monitors are flooded and a batch of session FIFOs hang up, with the
+ * main loop's class order and budgets, and in plain epoll order, and
+ * how many main loop wakeups, each with a full bookkeeping pass, a
+ * udev storm costs for a given udev budget. Also checks the mapping
+ * of event sources to classes, and that events for fds closed and
+ * reused earlier in a batch are ignored. */
+
+#define N_FIFOS 32U
+#define N_ROUNDS 2000U
+#define N_STORM 3000U
+
+#define UDEV_COST_USEC 50
+#define FIFO_COST_USEC 5
+
+/* What the main loop does between two epoll_wait() calls even when
+ * there is nothing to collect or set up, see manager_run() */
+#define BOOKKEEPING_COST_USEC 20
+
+static void test_classes(void) {
+        Manager *m;
+        int dummy;
+
+        assert_se(event_class_from_stats_source(STATS_FD_BUS) == EVENT_CLASS_BUS);
+        assert_se(event_class_from_stats_source(STATS_FD_TIMER) == EVENT_CLASS_TIMER);
+        assert_se(event_class_from_stats_source(STATS_FD_BUTTON) == EVENT_CLASS_TIMER);
+        assert_se(event_class_from_stats_source(STATS_FD_CONSOLE) == EVENT_CLASS_TIMER);
+        assert_se(event_class_from_stats_source(STATS_FD_SESSION) == EVENT_CLASS_FIFO);
+        assert_se(event_class_from_stats_source(STATS_FD_INHIBITOR) == EVENT_CLASS_FIFO);
+        assert_se(event_class_from_stats_source(STATS_FD_OTHER) == EVENT_CLASS_FIFO);
+        assert_se(event_class_from_stats_source(STATS_FD_SEAT_UDEV) == EVENT_CLASS_UDEV);
+        assert_se(event_class_from_stats_source(STATS_FD_VCSA_UDEV) == EVENT_CLASS_UDEV);
+        assert_se(event_class_from_stats_source(STATS_FD_BUTTON_UDEV) == EVENT_CLASS_UDEV);
+
+        m = new0(Manager, 1);
+        assert_se(m);
+
+        assert_se(manager_add_fd_object(m, 10, FD_OBJECT_BUTTON, &dummy) == 0);
+        assert_se(manager_add_fd_object(m, 11, FD_OBJECT_SESSION, &dummy) == 0);
+        assert_se(manager_add_fd_object(m, 12, FD_OBJECT_BUS, &dummy) == 0);
+
+        assert_se(manager_event_stats_source(m, FD_CONSOLE) == STATS_FD_CONSOLE);
+        assert_se(manager_event_stats_source(m, FD_SEAT_UDEV) == STATS_FD_SEAT_UDEV);
+        assert_se(manager_event_stats_source(m, FD_OTHER_BASE + 10) == STATS_FD_BUTTON);
+        assert_se(manager_event_stats_source(m, FD_OTHER_BASE + 11) == STATS_FD_SESSION);
+        assert_se(manager_event_stats_source(m, FD_OTHER_BASE + 12) == STATS_FD_BUS);
+        assert_se(manager_event_stats_source(m, FD_OTHER_BASE + 13) == STATS_FD_OTHER);
+        assert_se(manager_event_stats_source(m, FD_OTHER_BASE + 4096) == STATS_FD_OTHER);
+
+        free(m->fd_objects);
+        free(m);
+}
+
+static void test_stale(void) {
+        Manager *m;
+        int a, b;
+
+        m = new0(Manager, 1);
+        assert_se(m);
+
+        /* Registered during this wakeup, so not what an event of
+         * its batch is about */
+        m->n_wakeups = 1;
+        assert_se(manager_add_fd_object(m, 7, FD_OBJECT_SESSION, &a) == 0);
+        assert_se(!manager_get_fd_object(m, 7));
+
+        m->n_wakeups++;
+        assert_se(manager_get_fd_object(m, 7)->object == &a);
+
+        /* Closed by an earlier event of the batch */
+        assert_se(manager_remove_fd_object(m, 7) == &a);
+        assert_se(!manager_get_fd_object(m, 7));
+
+        /* ... and the number reused right away */
+        assert_se(manager_add_fd_object(m, 7, FD_OBJECT_INHIBITOR, &b) == 0);
+        assert_se(!manager_get_fd_object(m, 7));
+
+        m->n_wakeups++;
+        assert_se(manager_get_fd_object(m, 7)->object == &b);
+        assert_se(manager_get_fd_object(m, 7)->type == FD_OBJECT_INHIBITOR);
+
+        assert_se(!manager_get_fd_object(m, 8));
+        assert_se(!manager_get_fd_object(m, 4096));
+
+        free(m->fd_objects);
+        free(m);
+}
+
+static void spin(usec_t usec) {
+        usec_t until;
+
+        until = now(CLOCK_MONOTONIC) + usec;
+        while (now(CLOCK_MONOTONIC) < until)
+                ;
+}
+
+static const uint32_t udev_monitors[] = {
+        FD_SEAT_UDEV,
+        FD_VCSA_UDEV,
+        FD_BUTTON_UDEV,
+};
+
+typedef struct Loop {
+        Manager *m;
+        int efd;
+        int udev[ELEMENTSOF(udev_monitors)][2];
+        int fifos[N_FIFOS];
+        unsigned n_fifos;
+        int bus[2];
+
+        /* Put back what a udev event consumed */
+        bool refill;
+        unsigned udev_dispatched;
+
+        /* Stopped when a call on the bus is dispatched */
+        BenchTimer *call;
+} Loop;
+
+static void loop_add(Loop *l, int fd, uint32_t u) {
+        assert_se(epoll_ctl(l->efd, EPOLL_CTL_ADD, fd,
+                            &(struct epoll_event) { .events = EPOLLIN, .data.u32 = u }) == 0);
+}
+
+static void loop_open(Loop *l, unsigned udev_events, unsigned n_fifos, bool refill) {
+        static int dummy;
+        char buf[4096] = {};
+        unsigned i;
+
+        zero(*l);
+        l->refill = refill;
+
+        l->m = new0(Manager, 1);
+        assert_se(l->m);
+
+        l->efd = epoll_create1(EPOLL_CLOEXEC);
+        assert_se(l->efd >= 0);
+
+        /* udev monitors with udev_events devices queued between
+         * them */
+        for (i = 0; i < ELEMENTSOF(udev_monitors); i++) {
+                size_t n;
+
+                n = udev_events / ELEMENTSOF(udev_monitors);
+                assert_se(n <= sizeof(buf));
+
+                assert_se(pipe2(l->udev[i], O_CLOEXEC|O_NONBLOCK) == 0);
+                assert_se(write(l->udev[i][1], buf, n) == (ssize_t) n);
+                loop_add(l, l->udev[i][0], udev_monitors[i]);
+        }
+
+        /* Session FIFOs whose other end went away, which stay
+         * readable as long as nobody closes them */
+        for (i = 0; i < n_fifos; i++) {
+                int p[2];
+
+                assert_se(pipe2(p, O_CLOEXEC|O_NONBLOCK) == 0);
+                close_nointr_nofail(p[1]);
+                l->fifos[l->n_fifos++] = p[0];
+
+                assert_se(manager_add_fd_object(l->m, p[0], FD_OBJECT_SESSION, &dummy) == 0);
+                loop_add(l, p[0], FD_OTHER_BASE + p[0]);
+        }
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, l->bus) == 0);
+        assert_se(manager_add_fd_object(l->m, l->bus[0], FD_OBJECT_BUS, &dummy) == 0);
+        loop_add(l, l->bus[0], FD_OTHER_BASE + l->bus[0]);
+
+        /* Registered during wakeup 0 */
+        l->m->n_wakeups = 1;
+}
+
+static void loop_close(Loop *l) {
+        unsigned i;
+
+        for (i = 0; i < l->n_fifos; i++)
+                close_nointr_nofail(l->fifos[i]);
+        for (i = 0; i < ELEMENTSOF(udev_monitors); i++)
+                close_pipe(l->udev[i]);
+        close_pipe(l->bus);
+        close_nointr_nofail(l->efd);
+
+        free(l->m->fd_objects);
+        free(l->m);
+}
+
+/* One main loop wakeup, returns false if nothing was ready. Counts
+ * the events dispatched before a call on the bus, if one came in. */
+static bool loop_wakeup(Loop *l, bool prioritize, const unsigned budget[_EVENT_CLASS_MAX],
+                        bool *answered, unsigned long *before) {
+
+        struct epoll_event events[MANAGER_EVENTS_MAX];
+        EventClass classes[MANAGER_EVENTS_MAX];
+        unsigned order[MANAGER_EVENTS_MAX], class_end[_EVENT_CLASS_MAX];
+        unsigned k, n_order;
+        int n;
+
+        spin(BOOKKEEPING_COST_USEC);
+
+        n = epoll_wait(l->efd, events, ELEMENTSOF(events), 0);
+        assert_se(n >= 0);
+        if (n == 0)
+                return false;
+
+        l->m->n_wakeups++;
+
+        for (k = 0; k < (unsigned) n; k++)
+                classes[k] = prioritize ?
+                        event_class_from_stats_source(manager_event_stats_source(l->m, events[k].data.u32)) :
+                        EVENT_CLASS_BUS;
+
+        n_order = event_batch_order(classes, n, budget, order, class_end);
+
+        for (k = 0; k < n_order; k++) {
+                struct epoll_event *ev = events + order[k];
+                FdObject *o;
+                char c;
+
+                if (ev->data.u32 < FD_OTHER_BASE) {
+                        int *p;
+
+                        assert_se(ev->data.u32 - FD_SEAT_UDEV < ELEMENTSOF(udev_monitors));
+                        p = l->udev[ev->data.u32 - FD_SEAT_UDEV];
+
+                        /* One device per event, like
+                         * manager_dispatch_seat_udev() */
+                        assert_se(read(p[0], &c, 1) == 1);
+                        spin(UDEV_COST_USEC);
+                        if (l->refill)
+                                assert_se(write(p[1], &c, 1) == 1);
+
+                        l->udev_dispatched++;
+                        *before += !*answered;
+                        continue;
+                }
+
+                o = manager_get_fd_object(l->m, ev->data.u32 - FD_OTHER_BASE);
+                assert_se(o);
+
+                if (o->type == FD_OBJECT_BUS) {
+                        assert_se(read(l->bus[0], &c, 1) == 1);
+                        if (l->call)
+                                bench_timer_stop(l->call, 1);
+                        *answered = true;
+                } else {
+                        spin(FIFO_COST_USEC);
+                        *before += !*answered;
+                }
+        }
+
+        return true;
+}
+
+static void bench_flood(bool prioritize, unsigned udev_budget, const char *name) {
+        const unsigned budget[_EVENT_CLASS_MAX] = {
+                [EVENT_CLASS_FIFO] = 16,
+                [EVENT_CLASS_UDEV] = udev_budget,
+        };
+        static const unsigned no_budget[_EVENT_CLASS_MAX] = {};
+        BenchTimer latency = {};
+        unsigned long before = 0, wakeups = 0;
+        Loop l;
+        unsigned r;
+
+        loop_open(&l, 4096 * ELEMENTSOF(udev_monitors), N_FIFOS, true);
+        l.call = &latency;
+
+        for (r = 0; r < N_ROUNDS; r++) {
+                bool answered = false;
+
+                /* The CreateSession() call comes in */
+                bench_timer_start(&latency);
+                assert_se(write(l.bus[1], "C", 1) == 1);
+
+                while (!answered) {
+                        assert_se(loop_wakeup(&l, prioritize, prioritize ? budget : no_budget, &answered, &before));
+                        wakeups++;
+                }
+        }
+
+        /* With priorities the call is always the first thing
+         * dispatched by the very next wakeup */
+        if (prioritize) {
+                assert_se(before == 0);
+                assert_se(wakeups == N_ROUNDS);
+        }
+
+        bench_timer_report(&latency, name);
+        printf("%-50s %8.1f events/call %6.2f wakeups/call\n", name,
+               (double) before / N_ROUNDS, (double) wakeups / N_ROUNDS);
+
+        loop_close(&l);
+}
+
+static void bench_storm(unsigned udev_budget, const char *name) {
+        const unsigned budget[_EVENT_CLASS_MAX] = {
+                [EVENT_CLASS_FIFO] = 16,
+                [EVENT_CLASS_UDEV] = udev_budget,
+        };
+        BenchTimer storm = {};
+        unsigned long before = 0, wakeups = 0;
+        bool answered = false;
+        Loop l;
+
+        loop_open(&l, N_STORM, 0, false);
+
+        bench_timer_start(&storm);
+        while (loop_wakeup(&l, true, budget, &answered, &before))
+                wakeups++;
+        bench_timer_stop(&storm, N_STORM);
+
+        assert_se(l.udev_dispatched == N_STORM);
+
+        /* Each monitor is reported once per wakeup, so the budget
+         * saves wakeups until it covers all of them */
+        assert_se(wakeups == N_STORM / MIN(MAX(udev_budget, 1U), (unsigned) ELEMENTSOF(udev_monitors)));
+
+        bench_timer_report(&storm, name);
+        printf("%-50s %8.2f wakeups/udev event\n", name, (double) wakeups / N_STORM);
+
+        loop_close(&l);
+}
+
+int main(int argc, char *argv[]) {
+        test_classes();
+        test_stale();
+
+        bench_flood(true, 1, "CreateSession latency, udev flood, udev budget 1");
+        bench_flood(true, 16, "CreateSession latency, udev flood, udev budget 16");
+        bench_flood(false, 0, "CreateSession latency, udev flood, epoll order");
+
+        bench_storm(1, "udev storm n=3000, udev budget 1");
+        bench_storm(16, "udev storm n=3000, udev budget 16");
+
+        return 0;
+}
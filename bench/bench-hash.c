@@ -0,0 +1,102 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "bench.h"
+
+/* Compares the keyed string hash against the unkeyed DJB hash it
+ * replaced, on throughput and on how well the low bits spread, which
+ * is what picks a bucket */
+
+#define N_KEYS 100000U
+#define TABLE_BITS 17U
+
+static unsigned djb_hash_func(const void *p) {
+        unsigned hash = 5381;
+        const signed char *c;
+
+        for (c = p; *c; c++)
+                hash = (hash << 5) + hash + (unsigned) *c;
+
+        return hash;
+}
+
+static unsigned count_collisions(hash_func_t f, void **keys, unsigned n) {
+        uint8_t *used;
+        unsigned i, c = 0;
+
+        used = new0(uint8_t, 1U << TABLE_BITS);
+        assert_se(used);
+
+        for (i = 0; i < n; i++) {
+                unsigned b;
+
+                b = f(keys[i]) & ((1U << TABLE_BITS) - 1);
+                if (used[b])
+                        c++;
+                else
+                        used[b] = 1;
+        }
+
+        free(used);
+        return c;
+}
+
+static void bench_one(const char *fname, hash_func_t f, BenchKeyType t) {
+        BenchTimer timer = {};
+        void **keys;
+        unsigned r, rounds, i;
+        char name[64];
+
+        keys = bench_keys_new(t, N_KEYS);
+        rounds = bench_rounds(N_KEYS) * 10;
+
+        for (r = 0; r < rounds; r++) {
+                bench_timer_start(&timer);
+                for (i = 0; i < N_KEYS; i++)
+                        bench_sink += f(keys[i]);
+                bench_timer_stop(&timer, N_KEYS);
+        }
+
+        snprintf(name, sizeof(name), "%s %s", fname, bench_key_type_to_string(t));
+        bench_timer_report(&timer, name);
+
+        printf("%-48s %10u of %u keys share a bucket of %u\n",
+               name, count_collisions(f, keys, N_KEYS), N_KEYS, 1U << TABLE_BITS);
+
+        bench_keys_free(t, keys, N_KEYS);
+}
+
+int main(int argc, char *argv[]) {
+        BenchKeyType t;
+
+        hashmap_randomize_hash_key();
+
+        for (t = BENCH_KEY_SESSION_ID; t < _BENCH_KEY_TYPE_MAX; t++) {
+                bench_one("siphash13", string_hash_func, t);
+                bench_one("djb", djb_hash_func, t);
+        }
+
+        return 0;
+}
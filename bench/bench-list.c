@@ -0,0 +1,92 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+
+#include "util.h"
+#include "list.h"
+#include "bench.h"
+
+typedef struct Item Item;
+
+struct Item {
+        unsigned value;
+        LIST_FIELDS(Item, items);
+};
+
+static const unsigned sizes[] = { 100, 10000, 100000 };
+
+static void bench_one(unsigned n) {
+        BenchTimer prepend = {}, iterate = {}, find_tail = {}, remove = {};
+        LIST_HEAD(Item, head);
+        Item *items, *i, *tail;
+        unsigned r, rounds, k;
+        char name[64];
+
+        items = new0(Item, n);
+        assert_se(items);
+
+        rounds = bench_rounds(n);
+
+        for (r = 0; r < rounds; r++) {
+                LIST_HEAD_INIT(Item, head);
+
+                bench_timer_start(&prepend);
+                for (k = 0; k < n; k++)
+                        LIST_PREPEND(Item, items, head, items + k);
+                bench_timer_stop(&prepend, n);
+
+                bench_timer_start(&iterate);
+                LIST_FOREACH(items, i, head)
+                        bench_sink += i->value;
+                bench_timer_stop(&iterate, n);
+
+                bench_timer_start(&find_tail);
+                LIST_FIND_TAIL(Item, items, head, tail);
+                bench_timer_stop(&find_tail, 1);
+                bench_sink += (uintptr_t) tail;
+
+                /* Remove in insertion order, i.e. from the tail */
+                bench_timer_start(&remove);
+                for (k = 0; k < n; k++)
+                        LIST_REMOVE(Item, items, head, items + k);
+                bench_timer_stop(&remove, n);
+        }
+
+        snprintf(name, sizeof(name), "LIST_PREPEND n=%u", n);
+        bench_timer_report(&prepend, name);
+        snprintf(name, sizeof(name), "LIST_FOREACH n=%u", n);
+        bench_timer_report(&iterate, name);
+        snprintf(name, sizeof(name), "LIST_FIND_TAIL n=%u", n);
+        bench_timer_report(&find_tail, name);
+        snprintf(name, sizeof(name), "LIST_REMOVE n=%u", n);
+        bench_timer_report(&remove, name);
+
+        free(items);
+}
+
+int main(int argc, char *argv[]) {
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++)
+                bench_one(sizes[i]);
+
+        return 0;
+}
@@ -0,0 +1,135 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "mempool.h"
+#include "logind.h"
+#include "bench.h"
+
+/* Memory taken by a login storm of 50k sessions of 12.5k users, set
+ * up the way CreateSession() does, and what is left of it once they
+ * are gone: heap allocations per session and resident memory, before
+ * and after handing the pools back */
+
+#define N_SESSIONS 50000U
+#define SESSIONS_PER_USER 4U
+
+static const char *remote_hosts[] = {
+        "10.0.0.1",
+        "10.0.0.2",
+        "jumphost.example.com",
+        NULL,
+};
+
+static unsigned long rss_kb(void) {
+        unsigned long size, resident;
+        FILE *f;
+
+        f = fopen("/proc/self/statm", "re");
+        assert_se(f);
+        assert_se(fscanf(f, "%lu %lu", &size, &resident) == 2);
+        fclose(f);
+
+        return resident * (page_size() / 1024);
+}
+
+static void create_session(Manager *m, unsigned i) {
+        char id[DECIMAL_STR_MAX(unsigned) + 1], name[32], tty[16], *cgroup;
+        User *u;
+        Session *s;
+
+        snprintf(name, sizeof(name), "user%u", i / SESSIONS_PER_USER);
+        assert_se(manager_add_user(m, 1000 + i / SESSIONS_PER_USER, 100, name, &u) >= 0);
+
+        if (!u->cgroup_path) {
+                assert_se(asprintf(&u->cgroup_path, "/user/%s", u->name) >= 0);
+                assert_se(manager_cgroup_map_user(m, u->cgroup_path, u) >= 0);
+        }
+
+        snprintf(id, sizeof(id), "%u", i + 1);
+        assert_se(manager_add_session(m, u, id, &s) >= 0);
+
+        snprintf(tty, sizeof(tty), "pts/%u", i % 512);
+        assert_se(session_set_string(s, &s->tty, tty) >= 0);
+        assert_se(session_set_string(s, &s->remote_host, remote_hosts[i % ELEMENTSOF(remote_hosts)]) >= 0);
+        assert_se(session_set_string(s, &s->remote_user, u->name) >= 0);
+        assert_se(session_set_string(s, &s->service, "sshd") >= 0);
+
+        assert_se(asprintf(&cgroup, "%s/%s", u->cgroup_path, s->id) >= 0);
+        s->cgroup_path = cgroup;
+        assert_se(manager_cgroup_map_session(m, s->cgroup_path, s) >= 0);
+}
+
+int main(int argc, char *argv[]) {
+        BenchTimer create = {}, destroy = {};
+        unsigned long rss_before, rss_peak, rss_freed, rss_trimmed;
+        Manager *m;
+        User *u;
+        unsigned i;
+
+        m = new0(Manager, 1);
+        assert_se(m);
+
+        m->sessions = hashmap_new(string_hash_func, string_compare_func);
+        m->users = hashmap_new(trivial_hash_func, trivial_compare_func);
+        assert_se(m->sessions && m->users);
+
+        rss_before = rss_kb();
+
+        bench_timer_start(&create);
+        for (i = 0; i < N_SESSIONS; i++)
+                create_session(m, i);
+        bench_timer_stop(&create, N_SESSIONS);
+
+        rss_peak = rss_kb();
+
+        bench_timer_start(&destroy);
+        while ((u = hashmap_first(m->users)))
+                user_free(u);
+        bench_timer_stop(&destroy, N_SESSIONS);
+
+        assert_se(hashmap_isempty(m->sessions));
+
+        rss_freed = rss_kb();
+        mempool_trim_all();
+        rss_trimmed = rss_kb();
+
+        bench_timer_report(&create, "sessions create n=50000");
+        bench_timer_report(&destroy, "sessions free n=50000");
+
+        printf("%-50s %8lu kB %8.1f bytes/session\n", "sessions RSS n=50000",
+               rss_peak - rss_before, (double) (rss_peak - rss_before) * 1024 / N_SESSIONS);
+        printf("%-50s %8lu kB\n", "sessions RSS after free n=50000",
+               rss_freed > rss_before ? rss_freed - rss_before : 0);
+        printf("%-50s %8lu kB\n", "sessions RSS after trim n=50000",
+               rss_trimmed > rss_before ? rss_trimmed - rss_before : 0);
+
+        cgroup_node_free(m->cgroup_root);
+        intern_table_done(&m->interned);
+        hashmap_free(m->sessions);
+        hashmap_free(m->users);
+        free(m);
+
+        return 0;
+}
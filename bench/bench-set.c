@@ -0,0 +1,109 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+
+#include "util.h"
+#include "set.h"
+#include "bench.h"
+
+static const unsigned sizes[] = { 100, 10000, 100000 };
+
+static void bench_one(BenchKeyType t, unsigned n) {
+        BenchTimer put = {}, get = {}, iterate = {}, remove = {}, steal = {};
+        void **keys;
+        unsigned r, rounds, i;
+        char name[64];
+
+        keys = bench_keys_new(t, n);
+        rounds = bench_rounds(n);
+
+        for (r = 0; r < rounds; r++) {
+                Set *s;
+                Iterator j;
+                void *v;
+
+                if (t == BENCH_KEY_UID)
+                        s = set_new(trivial_hash_func, trivial_compare_func);
+                else
+                        s = set_new(string_hash_func, string_compare_func);
+                assert_se(s);
+
+                bench_timer_start(&put);
+                for (i = 0; i < n; i++)
+                        assert_se(set_put(s, keys[i]) == 1);
+                bench_timer_stop(&put, n);
+
+                bench_timer_start(&get);
+                for (i = 0; i < n; i++)
+                        bench_sink += (uintptr_t) set_get(s, keys[i]);
+                bench_timer_stop(&get, n);
+
+                bench_timer_start(&iterate);
+                SET_FOREACH(v, s, j)
+                        bench_sink += (uintptr_t) v;
+                bench_timer_stop(&iterate, n);
+
+                bench_timer_start(&remove);
+                for (i = 0; i < n; i++)
+                        assert_se(set_remove(s, keys[i]));
+                bench_timer_stop(&remove, n);
+
+                for (i = 0; i < n; i++)
+                        assert_se(set_put(s, keys[i]) == 1);
+
+                bench_timer_start(&steal);
+                while ((v = set_steal_first(s)))
+                        bench_sink += (uintptr_t) v;
+                bench_timer_stop(&steal, n);
+
+                set_free(s);
+        }
+
+#define REPORT(timer)                                                   \
+        do {                                                            \
+                snprintf(name, sizeof(name), "set %s %s n=%u",          \
+                         #timer, bench_key_type_to_string(t), n);       \
+                bench_timer_report(&timer, name);                       \
+        } while (false)
+
+        REPORT(put);
+        REPORT(get);
+        REPORT(iterate);
+        REPORT(remove);
+        REPORT(steal);
+
+#undef REPORT
+
+        bench_keys_free(t, keys, n);
+}
+
+int main(int argc, char *argv[]) {
+        BenchKeyType t;
+        unsigned i;
+
+        hashmap_randomize_hash_key();
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++)
+                for (t = 0; t < _BENCH_KEY_TYPE_MAX; t++)
+                        bench_one(t, sizes[i]);
+
+        return 0;
+}
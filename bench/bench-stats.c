@@ -0,0 +1,67 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdio.h>
+
+#include "util.h"
+#include "logind-stats.h"
+#include "bench.h"
+
+/* Cost of recording a dispatch latency, which the daemon does for
+ * every event and method call */
+
+#define N_OPS 1000000U
+
+int main(int argc, char *argv[]) {
+        BenchTimer record = {}, since = {}, method = {};
+        Stats s;
+        unsigned r, rounds, k;
+        usec_t start;
+
+        stats_init(&s);
+        rounds = bench_rounds(N_OPS);
+
+        for (r = 0; r < rounds; r++) {
+                bench_timer_start(&record);
+                for (k = 0; k < N_OPS; k++)
+                        stats_record(&s, STATS_FD_BUS, (k * 2654435761U) >> 20);
+                bench_timer_stop(&record, N_OPS);
+
+                bench_timer_start(&since);
+                start = now(CLOCK_MONOTONIC);
+                for (k = 0; k < N_OPS; k++)
+                        start = stats_record_since(&s, STATS_FD_BUS, start);
+                bench_timer_stop(&since, N_OPS);
+
+                bench_timer_start(&method);
+                for (k = 0; k < N_OPS; k++)
+                        stats_record_method(&s, "org.freedesktop.login1.Manager.ListSessions", k & 1023);
+                bench_timer_stop(&method, N_OPS);
+        }
+
+        bench_sink += s.sources[STATS_FD_BUS].sum;
+
+        bench_timer_report(&record, "stats record");
+        bench_timer_report(&since, "stats record since (with clock read)");
+        bench_timer_report(&method, "stats record method");
+
+        stats_done(&s);
+
+        return 0;
+}
@@ -0,0 +1,106 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+
+#include "util.h"
+#include "strv.h"
+#include "bench.h"
+
+/* strv_contains() is used on short lists of controllers and user
+ * names, strv_extend() builds up lists of any length */
+
+static const unsigned sizes[] = { 4, 16, 64, 1024 };
+
+static char **make_names(unsigned n, const char *prefix) {
+        char **l;
+        unsigned i;
+
+        l = new0(char*, n + 1);
+        assert_se(l);
+
+        for (i = 0; i < n; i++)
+                assert_se(asprintf(&l[i], "%s%u", prefix, i) >= 0);
+
+        return l;
+}
+
+static void bench_contains(unsigned n) {
+        BenchTimer hit = {}, miss = {};
+        _cleanup_strv_free_ char **l = NULL, **absent = NULL;
+        unsigned r, rounds, i;
+        char name[64];
+
+        l = make_names(n, "controller");
+        absent = make_names(n, "missing");
+        rounds = bench_rounds(n);
+
+        for (r = 0; r < rounds; r++) {
+                bench_timer_start(&hit);
+                for (i = 0; i < n; i++)
+                        bench_sink += strv_contains(l, l[i]);
+                bench_timer_stop(&hit, n);
+
+                bench_timer_start(&miss);
+                for (i = 0; i < n; i++)
+                        bench_sink += strv_contains(l, absent[i]);
+                bench_timer_stop(&miss, n);
+        }
+
+        snprintf(name, sizeof(name), "strv_contains hit n=%u", n);
+        bench_timer_report(&hit, name);
+        snprintf(name, sizeof(name), "strv_contains miss n=%u", n);
+        bench_timer_report(&miss, name);
+}
+
+static void bench_extend(unsigned n) {
+        BenchTimer extend = {};
+        _cleanup_strv_free_ char **names = NULL;
+        unsigned r, rounds, i;
+        char name[64];
+
+        names = make_names(n, "user");
+        rounds = bench_rounds(n);
+
+        for (r = 0; r < rounds; r++) {
+                char **l = NULL;
+
+                bench_timer_start(&extend);
+                for (i = 0; i < n; i++)
+                        assert_se(strv_extend(&l, names[i]) >= 0);
+                bench_timer_stop(&extend, n);
+
+                strv_free(l);
+        }
+
+        snprintf(name, sizeof(name), "strv_extend n=%u", n);
+        bench_timer_report(&extend, name);
+}
+
+int main(int argc, char *argv[]) {
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(sizes); i++) {
+                bench_contains(sizes[i]);
+                bench_extend(sizes[i]);
+        }
+
+        return 0;
+}
@@ -0,0 +1,175 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "util.h"
+#include "bench.h"
+
+volatile uintptr_t bench_sink = 0;
+
+/* Count heap allocations by interposing the allocator, the real
+ * implementations are reachable through glibc's __libc_ aliases */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static unsigned long n_allocations = 0;
+
+void *malloc(size_t size) {
+        n_allocations++;
+        return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+        n_allocations++;
+        return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *p, size_t size) {
+        n_allocations++;
+        return __libc_realloc(p, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+        void *p;
+
+        n_allocations++;
+
+        p = __libc_memalign(alignment, size);
+        if (!p)
+                return ENOMEM;
+
+        *memptr = p;
+        return 0;
+}
+
+unsigned long bench_allocations(void) {
+        return n_allocations;
+}
+
+static uint64_t now_nsec(void) {
+        struct timespec ts;
+
+        assert_se(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+        return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void bench_timer_start(BenchTimer *t) {
+        assert(t);
+
+        t->start_allocs = n_allocations;
+        t->start_nsec = now_nsec();
+}
+
+void bench_timer_stop(BenchTimer *t, unsigned long n_ops) {
+        uint64_t n;
+
+        assert(t);
+
+        n = now_nsec();
+
+        t->nsec += n - t->start_nsec;
+        t->allocs += n_allocations - t->start_allocs;
+        t->n_ops += n_ops;
+}
+
+void bench_timer_report(const BenchTimer *t, const char *name) {
+        assert(t);
+        assert(name);
+
+        if (t->n_ops == 0)
+                return;
+
+        printf("%-48s %10.1f ns/op %8.3f allocs/op\n",
+               name,
+               (double) t->nsec / t->n_ops,
+               (double) t->allocs / t->n_ops);
+}
+
+static const char* const bench_key_type_table[_BENCH_KEY_TYPE_MAX] = {
+        [BENCH_KEY_UID] = "uid",
+        [BENCH_KEY_SESSION_ID] = "session-id",
+        [BENCH_KEY_SYSFS_PATH] = "sysfs-path",
+        [BENCH_KEY_CGROUP_PATH] = "cgroup-path",
+};
+
+const char *bench_key_type_to_string(BenchKeyType t) {
+        assert(t >= 0 && t < _BENCH_KEY_TYPE_MAX);
+
+        return bench_key_type_table[t];
+}
+
+void **bench_keys_new(BenchKeyType t, unsigned n) {
+        void **keys;
+        unsigned i;
+
+        keys = new(void*, n);
+        assert_se(keys);
+
+        for (i = 0; i < n; i++) {
+                char *k = NULL;
+
+                switch (t) {
+
+                case BENCH_KEY_UID:
+                        keys[i] = UINT_TO_PTR(1000 + i);
+                        continue;
+
+                case BENCH_KEY_SESSION_ID:
+                        assert_se(asprintf(&k, "c%u", i + 1) >= 0);
+                        break;
+
+                case BENCH_KEY_SYSFS_PATH:
+                        assert_se(asprintf(&k, "/sys/devices/pci0000:00/0000:00:14.0/usb%u/%u-%u/%u-%u:1.0/input/input%u",
+                                           i % 4 + 1, i % 4 + 1, i / 4 % 16 + 1, i % 4 + 1, i / 4 % 16 + 1, i) >= 0);
+                        break;
+
+                case BENCH_KEY_CGROUP_PATH:
+                        assert_se(asprintf(&k, "/user/%u.user/c%u.session", 1000 + i % 997, i + 1) >= 0);
+                        break;
+
+                default:
+                        assert_not_reached("Unknown key type");
+                }
+
+                keys[i] = k;
+        }
+
+        return keys;
+}
+
+void bench_keys_free(BenchKeyType t, void **keys, unsigned n) {
+        unsigned i;
+
+        if (t != BENCH_KEY_UID)
+                for (i = 0; i < n; i++)
+                        free(keys[i]);
+
+        free(keys);
+}
+
+unsigned bench_rounds(unsigned n) {
+        return MAX(1U, 200000U / n);
+}
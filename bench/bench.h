@@ -0,0 +1,66 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdint.h>
+
+/* Tiny harness for the container micro benchmarks, see "make bench".
+ * Timers accumulate wall clock time and heap allocations over any
+ * number of start/stop pairs, and report them per operation. */
+
+typedef struct BenchTimer {
+        uint64_t nsec;
+        unsigned long allocs;
+        unsigned long n_ops;
+
+        uint64_t start_nsec;
+        unsigned long start_allocs;
+} BenchTimer;
+
+void bench_timer_start(BenchTimer *t);
+void bench_timer_stop(BenchTimer *t, unsigned long n_ops);
+void bench_timer_report(const BenchTimer *t, const char *name);
+
+/* Number of malloc(), calloc(), realloc() and posix_memalign() calls
+ * so far */
+unsigned long bench_allocations(void);
+
+typedef enum BenchKeyType {
+        BENCH_KEY_UID,
+        BENCH_KEY_SESSION_ID,
+        BENCH_KEY_SYSFS_PATH,
+        BENCH_KEY_CGROUP_PATH,
+        _BENCH_KEY_TYPE_MAX
+} BenchKeyType;
+
+const char *bench_key_type_to_string(BenchKeyType t);
+
+/* Returns n distinct keys shaped like the ones logind keeps in its
+ * maps. UIDs are returned as pointers, see UINT_TO_PTR(). */
+void **bench_keys_new(BenchKeyType t, unsigned n);
+void bench_keys_free(BenchKeyType t, void **keys, unsigned n);
+
+/* Rounds to repeat a pass over n keys, so that every size runs for a
+ * comparable time */
+unsigned bench_rounds(unsigned n);
+
+/* Keeps the compiler from dropping lookups whose result is unused */
+extern volatile uintptr_t bench_sink;
@@ -0,0 +1,146 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+
+#include "util.h"
+#include "dbus-common.h"
+#include "dbus-call.h"
+
+struct BusCall {
+        DBusPendingCall *pending;
+        bus_call_callback_t callback;
+        void *userdata;
+};
+
+static void bus_call_free(BusCall *call) {
+        if (!call)
+                return;
+
+        if (call->pending)
+                dbus_pending_call_unref(call->pending);
+
+        free(call);
+}
+
+static void bus_call_notify(DBusPendingCall *pending, void *userdata) {
+        BusCall *call = userdata;
+        DBusMessage *reply;
+        DBusError error;
+        int r = 0;
+
+        assert(call);
+        assert(call->pending == pending);
+
+        dbus_error_init(&error);
+
+        reply = dbus_pending_call_steal_reply(pending);
+        if (!reply) {
+                dbus_set_error_const(&error, DBUS_ERROR_NO_REPLY, "No reply");
+                r = -ETIMEDOUT;
+        } else if (dbus_set_error_from_message(&error, reply))
+                r = bus_error_to_errno(&error);
+
+        call->callback(call, r, r < 0 ? NULL : reply, &error, call->userdata);
+
+        if (reply)
+                dbus_message_unref(reply);
+
+        dbus_error_free(&error);
+        bus_call_free(call);
+}
+
+int bus_call_async(
+                DBusConnection *bus,
+                usec_t timeout,
+                bus_call_callback_t callback,
+                void *userdata,
+                BusCall **ret,
+                const char *destination,
+                const char *path,
+                const char *interface,
+                const char *method,
+                int first_arg_type, ...) {
+
+        _cleanup_dbus_message_unref_ DBusMessage *m = NULL;
+        BusCall *call;
+        va_list ap;
+        int timeout_ms;
+        bool b;
+
+        assert(bus);
+        assert(callback);
+        assert(method);
+
+        m = dbus_message_new_method_call(destination, path, interface, method);
+        if (!m)
+                return -ENOMEM;
+
+        va_start(ap, first_arg_type);
+        b = dbus_message_append_args_valist(m, first_arg_type, ap);
+        va_end(ap);
+
+        if (!b)
+                return -ENOMEM;
+
+        /* 0 selects the library's default timeout */
+        if (timeout <= 0)
+                timeout_ms = -1;
+        else
+                timeout_ms = (int) MIN((timeout + USEC_PER_MSEC - 1) / USEC_PER_MSEC, (usec_t) INT_MAX);
+
+        call = new0(BusCall, 1);
+        if (!call)
+                return -ENOMEM;
+
+        call->callback = callback;
+        call->userdata = userdata;
+
+        if (!dbus_connection_send_with_reply(bus, m, &call->pending, timeout_ms)) {
+                free(call);
+                return -ENOMEM;
+        }
+
+        if (!call->pending) {
+                free(call);
+                return -ENOTCONN;
+        }
+
+        if (!dbus_pending_call_set_notify(call->pending, bus_call_notify, call, NULL)) {
+                dbus_pending_call_cancel(call->pending);
+                bus_call_free(call);
+                return -ENOMEM;
+        }
+
+        if (ret)
+                *ret = call;
+
+        return 0;
+}
+
+void bus_call_cancel(BusCall *call) {
+        if (!call)
+                return;
+
+        dbus_pending_call_cancel(call->pending);
+        bus_call_free(call);
+}
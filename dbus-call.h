@@ -0,0 +1,50 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <dbus/dbus.h>
+
+#include "time-util.h"
+
+/* Method calls to other services that don't wait for the reply. The
+ * callback is run from dbus_connection_dispatch() once the reply is
+ * in, the call failed or it timed out; r is 0 and reply set on
+ * success, and a negative errno plus error otherwise. Timeouts go
+ * through the bus loop's timer queue like all other bus timeouts. */
+
+typedef struct BusCall BusCall;
+
+typedef void (*bus_call_callback_t)(BusCall *call, int r, DBusMessage *reply, DBusError *error, void *userdata);
+
+int bus_call_async(
+                DBusConnection *bus,
+                usec_t timeout,
+                bus_call_callback_t callback,
+                void *userdata,
+                BusCall **ret,
+                const char *destination,
+                const char *path,
+                const char *interface,
+                const char *method,
+                int first_arg_type, ...);
+
+/* Drops the call without running its callback. Not to be called from
+ * the callback itself, the call is freed after it returns. */
+void bus_call_cancel(BusCall *call);
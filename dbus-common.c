@@ -265,6 +265,49 @@ const char *bus_error(const DBusError *error, int err) {
         return strerror(err < 0 ? -err : err);
 }
 
+int bus_append_properties(DBusMessageIter *iter, const BusBoundProperties *bound_properties, const char *interface) {
+        const BusBoundProperties *bp;
+        const BusProperty *p;
+        DBusMessageIter sub, sub2, sub3;
+        int r;
+
+        assert(iter);
+        assert(bound_properties);
+
+        if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "{sv}", &sub))
+                return -ENOMEM;
+
+        for (bp = bound_properties; bp->interface; bp++) {
+                if (!isempty(interface) && !streq(bp->interface, interface))
+                        continue;
+
+                for (p = bp->properties; p->property; p++) {
+                        void *data;
+
+                        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_DICT_ENTRY, NULL, &sub2) ||
+                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &p->property) ||
+                            !dbus_message_iter_open_container(&sub2, DBUS_TYPE_VARIANT, p->signature, &sub3))
+                                return -ENOMEM;
+
+                        data = (char*)bp->base + p->offset;
+                        if (p->indirect)
+                                data = *(void**)data;
+                        r = p->append(&sub3, p->property, data);
+                        if (r < 0)
+                                return r;
+
+                        if (!dbus_message_iter_close_container(&sub2, &sub3) ||
+                            !dbus_message_iter_close_container(&sub, &sub2))
+                                return -ENOMEM;
+                }
+        }
+
+        if (!dbus_message_iter_close_container(iter, &sub))
+                return -ENOMEM;
+
+        return 0;
+}
+
 DBusHandlerResult bus_default_message_handler(
                 DBusConnection *c,
                 DBusMessage *message,
@@ -347,9 +390,7 @@ get_prop:
 
         } else if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Properties", "GetAll") && bound_properties) {
                 const char *interface;
-                const BusBoundProperties *bp;
-                const BusProperty *p;
-                DBusMessageIter iter, sub, sub2, sub3;
+                DBusMessageIter iter;
 
                 if (!dbus_message_get_args(
                             message,
@@ -369,38 +410,11 @@ get_prop:
 
                 dbus_message_iter_init_append(reply, &iter);
 
-                if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &sub))
-                        goto oom;
-
-                for (bp = bound_properties; bp->interface; bp++) {
-                        if (interface[0] && !streq(bp->interface, interface))
-                                continue;
-
-                        for (p = bp->properties; p->property; p++) {
-                                void *data;
-
-                                if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_DICT_ENTRY, NULL, &sub2) ||
-                                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &p->property) ||
-                                    !dbus_message_iter_open_container(&sub2, DBUS_TYPE_VARIANT, p->signature, &sub3))
-                                        goto oom;
-
-                                data = (char*)bp->base + p->offset;
-                                if (p->indirect)
-                                        data = *(void**)data;
-                                r = p->append(&sub3, p->property, data);
-                                if (r == -ENOMEM)
-                                        goto oom;
-                                if (r < 0)
-                                        return bus_send_error_reply(c, message, NULL, r);
-
-                                if (!dbus_message_iter_close_container(&sub2, &sub3) ||
-                                    !dbus_message_iter_close_container(&sub, &sub2))
-                                        goto oom;
-                        }
-                }
-
-                if (!dbus_message_iter_close_container(&iter, &sub))
+                r = bus_append_properties(&iter, bound_properties, interface);
+                if (r == -ENOMEM)
                         goto oom;
+                if (r < 0)
+                        return bus_send_error_reply(c, message, NULL, r);
 
         } else if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Properties", "Set") && bound_properties) {
                 const char *interface, *property;
@@ -1339,6 +1353,19 @@ bool bus_error_is_no_service(const DBusError *error) {
         return startswith(error->name, "org.freedesktop.DBus.Error.Spawn.");
 }
 
+int bus_error_to_errno(const DBusError *error) {
+        assert(error);
+
+        if (bus_error_is_no_service(error))
+                return -ENOENT;
+        else if (dbus_error_has_name(error, DBUS_ERROR_ACCESS_DENIED))
+                return -EACCES;
+        else if (dbus_error_has_name(error, DBUS_ERROR_NO_REPLY))
+                return -ETIMEDOUT;
+        else
+                return -EIO;
+}
+
 int bus_method_call_with_reply(
                 DBusConnection *bus,
                 const char *destination,
@@ -1377,14 +1404,7 @@ int bus_method_call_with_reply(
                 if (!return_error)
                         log_error("Failed to issue method call: %s", bus_error_message(&error));
 
-                if (bus_error_is_no_service(&error))
-                        r = -ENOENT;
-                else if (dbus_error_has_name(&error, DBUS_ERROR_ACCESS_DENIED))
-                        r = -EACCES;
-                else if (dbus_error_has_name(&error, DBUS_ERROR_NO_REPLY))
-                        r = -ETIMEDOUT;
-                else
-                        r = -EIO;
+                r = bus_error_to_errno(&error);
                 goto finish;
         }
 
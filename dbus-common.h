@@ -133,6 +133,10 @@ DBusHandlerResult bus_default_message_handler(
                 const char *interfaces,
                 const BusBoundProperties *bound_properties);
 
+/* Appends the properties of interface, or of all interfaces if it is
+ * NULL or empty, as a{sv} */
+int bus_append_properties(DBusMessageIter *iter, const BusBoundProperties *bound_properties, const char *interface);
+
 int bus_property_append_string(DBusMessageIter *i, const char *property, void *data);
 int bus_property_append_strv(DBusMessageIter *i, const char *property, void *data);
 int bus_property_append_bool(DBusMessageIter *i, const char *property, void *data);
@@ -229,6 +233,7 @@ DBusHandlerResult bus_exit_idle_filter(DBusConnection *bus, DBusMessage *m, void
 pid_t bus_get_unix_process_id(DBusConnection *connection, const char *name, DBusError *error);
 
 bool bus_error_is_no_service(const DBusError *error);
+int bus_error_to_errno(const DBusError *error);
 int bus_method_call_with_reply(DBusConnection *bus,
                                const char *destination,
                                const char *path,
@@ -0,0 +1,449 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <string.h>
+
+#include "util.h"
+#include "dbus-common.h"
+#include "dbus-creds.h"
+
+typedef struct BusCredsWaiter {
+        DBusMessage *request;
+        DBusObjectPathMessageFunction dispatch;
+        void *userdata;
+} BusCredsWaiter;
+
+typedef struct BusCredsEntry {
+        BusCreds creds;
+
+        BusCredsCache *cache;
+        DBusConnection *bus;
+        char *name;
+
+        /* Lookup in progress, and the requests waiting for it */
+        DBusPendingCall *pending[2];
+        bool have_uid:1;
+        bool have_pid:1;
+        int error;
+
+        BusCredsWaiter *waiters;
+        unsigned n_waiters;
+} BusCredsEntry;
+
+static void entry_free(BusCredsEntry *e) {
+        unsigned i;
+
+        if (!e)
+                return;
+
+        hashmap_remove(e->cache->names, e->name);
+
+        for (i = 0; i < ELEMENTSOF(e->pending); i++)
+                if (e->pending[i]) {
+                        dbus_pending_call_cancel(e->pending[i]);
+                        dbus_pending_call_unref(e->pending[i]);
+                }
+
+        for (i = 0; i < e->n_waiters; i++)
+                dbus_message_unref(e->waiters[i].request);
+        free(e->waiters);
+
+        if (e->bus)
+                dbus_connection_unref(e->bus);
+
+        free(e->name);
+        free(e);
+}
+
+static bool entry_busy(BusCredsEntry *e) {
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(e->pending); i++)
+                if (e->pending[i])
+                        return true;
+
+        return false;
+}
+
+static int entry_call(BusCredsEntry *e, const char *method, DBusPendingCallNotifyFunction notify) {
+        _cleanup_dbus_message_unref_ DBusMessage *m = NULL;
+        DBusPendingCall *pending = NULL;
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(e->pending); i++)
+                if (!e->pending[i])
+                        break;
+
+        assert(i < ELEMENTSOF(e->pending));
+
+        m = dbus_message_new_method_call(
+                        DBUS_SERVICE_DBUS,
+                        DBUS_PATH_DBUS,
+                        DBUS_INTERFACE_DBUS,
+                        method);
+        if (!m)
+                return -ENOMEM;
+
+        if (!dbus_message_append_args(m, DBUS_TYPE_STRING, &e->name, DBUS_TYPE_INVALID))
+                return -ENOMEM;
+
+        if (!dbus_connection_send_with_reply(e->bus, m, &pending, -1))
+                return -ENOMEM;
+
+        if (!pending)
+                return -ENOTCONN;
+
+        if (!dbus_pending_call_set_notify(pending, notify, e, NULL)) {
+                dbus_pending_call_cancel(pending);
+                dbus_pending_call_unref(pending);
+                return -ENOMEM;
+        }
+
+        e->pending[i] = pending;
+        return 0;
+}
+
+static DBusMessage *entry_steal_reply(BusCredsEntry *e, DBusPendingCall *pending) {
+        DBusMessage *reply;
+        unsigned i;
+
+        for (i = 0; i < ELEMENTSOF(e->pending); i++)
+                if (e->pending[i] == pending)
+                        break;
+
+        assert(i < ELEMENTSOF(e->pending));
+
+        reply = dbus_pending_call_steal_reply(pending);
+        dbus_pending_call_unref(pending);
+        e->pending[i] = NULL;
+
+        return reply;
+}
+
+static bool entry_reply_ok(BusCredsEntry *e, DBusMessage *reply) {
+        int r;
+
+        if (!reply)
+                r = -EIO;
+        else if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)
+                r = dbus_message_is_error(reply, DBUS_ERROR_NAME_HAS_NO_OWNER) ? -ESRCH : -EIO;
+        else
+                return true;
+
+        if (e->error == 0)
+                e->error = r;
+
+        return false;
+}
+
+static void entry_finish(BusCredsEntry *e) {
+        BusCredsWaiter *waiters;
+        unsigned n_waiters, i;
+        int r;
+
+        if (entry_busy(e))
+                return;
+
+        if (e->error == 0) {
+                if (!e->have_uid || !e->have_pid)
+                        e->error = -EIO;
+                else {
+                        r = get_starttime_of_pid(e->creds.pid, &e->creds.starttime);
+                        if (r < 0)
+                                e->error = r;
+                }
+        }
+
+        /* Run the parked requests again; this time they'll find the
+         * credentials, or the error */
+        waiters = e->waiters;
+        n_waiters = e->n_waiters;
+        e->waiters = NULL;
+        e->n_waiters = 0;
+
+        for (i = 0; i < n_waiters; i++) {
+                waiters[i].dispatch(e->bus, waiters[i].request, waiters[i].userdata);
+                dbus_message_unref(waiters[i].request);
+        }
+
+        free(waiters);
+
+        /* Failures are not cached, the next request will try again */
+        if (e->error != 0)
+                entry_free(e);
+}
+
+static int parse_uint32(DBusMessageIter *iter, uint32_t *u) {
+
+        if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_UINT32)
+                return -EIO;
+
+        dbus_message_iter_get_basic(iter, u);
+        return 0;
+}
+
+static int entry_start_legacy(BusCredsEntry *e);
+
+static void credentials_notify(DBusPendingCall *pending, void *userdata) {
+        BusCredsEntry *e = userdata;
+        DBusMessage *reply;
+        DBusMessageIter iter, sub;
+
+        reply = entry_steal_reply(e, pending);
+
+        /* Older buses don't know GetConnectionCredentials */
+        if (reply && dbus_message_is_error(reply, DBUS_ERROR_UNKNOWN_METHOD)) {
+                e->cache->legacy = true;
+                e->error = entry_start_legacy(e);
+                goto finish;
+        }
+
+        if (!entry_reply_ok(e, reply))
+                goto finish;
+
+        if (!dbus_message_iter_init(reply, &iter) ||
+            dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+            dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_DICT_ENTRY) {
+                e->error = -EIO;
+                goto finish;
+        }
+
+        dbus_message_iter_recurse(&iter, &sub);
+
+        while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_DICT_ENTRY) {
+                DBusMessageIter entry, variant;
+                const char *key;
+                uint32_t u;
+
+                dbus_message_iter_recurse(&sub, &entry);
+
+                if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING) {
+                        e->error = -EIO;
+                        goto finish;
+                }
+
+                dbus_message_iter_get_basic(&entry, &key);
+
+                if (!dbus_message_iter_next(&entry) ||
+                    dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT) {
+                        e->error = -EIO;
+                        goto finish;
+                }
+
+                dbus_message_iter_recurse(&entry, &variant);
+
+                if (streq(key, "UnixUserID")) {
+                        if (parse_uint32(&variant, &u) < 0) {
+                                e->error = -EIO;
+                                goto finish;
+                        }
+
+                        e->creds.uid = (uid_t) u;
+                        e->have_uid = true;
+
+                } else if (streq(key, "ProcessID")) {
+                        if (parse_uint32(&variant, &u) < 0) {
+                                e->error = -EIO;
+                                goto finish;
+                        }
+
+                        e->creds.pid = (pid_t) u;
+                        e->have_pid = true;
+                }
+
+                dbus_message_iter_next(&sub);
+        }
+
+finish:
+        if (reply)
+                dbus_message_unref(reply);
+
+        entry_finish(e);
+}
+
+static void unix_user_notify(DBusPendingCall *pending, void *userdata) {
+        BusCredsEntry *e = userdata;
+        DBusMessage *reply;
+        DBusMessageIter iter;
+        uint32_t u;
+
+        reply = entry_steal_reply(e, pending);
+        if (entry_reply_ok(e, reply)) {
+                if (!dbus_message_iter_init(reply, &iter) ||
+                    parse_uint32(&iter, &u) < 0)
+                        e->error = -EIO;
+                else {
+                        e->creds.uid = (uid_t) u;
+                        e->have_uid = true;
+                }
+        }
+
+        if (reply)
+                dbus_message_unref(reply);
+
+        entry_finish(e);
+}
+
+static void process_id_notify(DBusPendingCall *pending, void *userdata) {
+        BusCredsEntry *e = userdata;
+        DBusMessage *reply;
+        DBusMessageIter iter;
+        uint32_t u;
+
+        reply = entry_steal_reply(e, pending);
+        if (entry_reply_ok(e, reply)) {
+                if (!dbus_message_iter_init(reply, &iter) ||
+                    parse_uint32(&iter, &u) < 0)
+                        e->error = -EIO;
+                else {
+                        e->creds.pid = (pid_t) u;
+                        e->have_pid = true;
+                }
+        }
+
+        if (reply)
+                dbus_message_unref(reply);
+
+        entry_finish(e);
+}
+
+static int entry_start_legacy(BusCredsEntry *e) {
+        int r;
+
+        /* Both calls are in flight at the same time */
+        r = entry_call(e, "GetConnectionUnixUser", unix_user_notify);
+        if (r < 0)
+                return r;
+
+        return entry_call(e, "GetConnectionUnixProcessID", process_id_notify);
+}
+
+void bus_creds_cache_init(BusCredsCache *c) {
+        assert(c);
+
+        zero(*c);
+}
+
+void bus_creds_cache_done(BusCredsCache *c) {
+        BusCredsEntry *e;
+
+        assert(c);
+
+        while ((e = hashmap_first(c->names)))
+                entry_free(e);
+
+        hashmap_free(c->names);
+        c->names = NULL;
+}
+
+void bus_creds_cache_forget(BusCredsCache *c, const char *name) {
+        assert(c);
+        assert(name);
+
+        /* Requests still waiting came from a peer that is gone now,
+         * they are dropped without a reply */
+        entry_free(hashmap_get(c->names, name));
+}
+
+int bus_creds_get_async(
+                BusCredsCache *c,
+                DBusConnection *bus,
+                DBusMessage *request,
+                const BusCreds **creds,
+                DBusObjectPathMessageFunction dispatch,
+                void *userdata) {
+
+        BusCredsEntry *e;
+        BusCredsWaiter *w;
+        const char *sender;
+        int r;
+
+        assert(c);
+        assert(bus);
+        assert(request);
+        assert(creds);
+        assert(dispatch);
+
+        sender = dbus_message_get_sender(request);
+        if (!sender)
+                return -EINVAL;
+
+        e = hashmap_get(c->names, sender);
+        if (e && !entry_busy(e)) {
+                if (e->error != 0)
+                        return e->error;
+
+                c->n_hits++;
+                *creds = &e->creds;
+                return 0;
+        }
+
+        if (!e) {
+                c->n_misses++;
+
+                r = hashmap_ensure_allocated(&c->names, string_hash_func, string_compare_func);
+                if (r < 0)
+                        return r;
+
+                e = new0(BusCredsEntry, 1);
+                if (!e)
+                        return -ENOMEM;
+
+                e->cache = c;
+                e->bus = dbus_connection_ref(bus);
+
+                e->name = strdup(sender);
+                if (!e->name) {
+                        dbus_connection_unref(e->bus);
+                        free(e);
+                        return -ENOMEM;
+                }
+
+                r = hashmap_put(c->names, e->name, e);
+                if (r < 0) {
+                        dbus_connection_unref(e->bus);
+                        free(e->name);
+                        free(e);
+                        return r;
+                }
+
+                if (c->legacy)
+                        r = entry_start_legacy(e);
+                else
+                        r = entry_call(e, "GetConnectionCredentials", credentials_notify);
+                if (r < 0) {
+                        entry_free(e);
+                        return r;
+                }
+        }
+
+        w = realloc(e->waiters, sizeof(BusCredsWaiter) * (e->n_waiters + 1));
+        if (!w)
+                return -ENOMEM;
+
+        e->waiters = w;
+        w[e->n_waiters].request = dbus_message_ref(request);
+        w[e->n_waiters].dispatch = dispatch;
+        w[e->n_waiters].userdata = userdata;
+        e->n_waiters++;
+
+        return -EINPROGRESS;
+}
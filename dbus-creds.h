@@ -0,0 +1,66 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <dbus/dbus.h>
+
+#include "hashmap.h"
+
+/* Caches the credentials of bus peers by unique name. Unique names
+ * are never reused during the lifetime of a bus, so entries stay
+ * valid until the peer disconnects, which the owner should pass on
+ * with bus_creds_cache_forget(). Unknown credentials are requested
+ * from dbus-daemon asynchronously, while the request that needed
+ * them is parked. */
+
+typedef struct BusCreds {
+        uid_t uid;
+        pid_t pid;
+        unsigned long long starttime;
+} BusCreds;
+
+typedef struct BusCredsCache {
+        Hashmap *names;
+
+        /* The bus doesn't know GetConnectionCredentials, use the
+         * older per-item calls instead */
+        bool legacy;
+
+        uint64_t n_hits;
+        uint64_t n_misses;
+} BusCredsCache;
+
+void bus_creds_cache_init(BusCredsCache *c);
+void bus_creds_cache_done(BusCredsCache *c);
+void bus_creds_cache_forget(BusCredsCache *c, const char *name);
+
+/* Returns 0 and the sender's credentials if they are known. Otherwise
+ * parks the request and returns -EINPROGRESS; the caller should then
+ * return without replying, and dispatch() is called again for the
+ * request once the credentials came in. */
+int bus_creds_get_async(
+                BusCredsCache *c,
+                DBusConnection *bus,
+                DBusMessage *request,
+                const BusCreds **creds,
+                DBusObjectPathMessageFunction dispatch,
+                void *userdata);
@@ -24,226 +24,368 @@
 #include <sys/epoll.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/timerfd.h>
 #include <unistd.h>
 
 #include "dbus-loop.h"
 #include "dbus-common.h"
+#include "hashmap.h"
+#include "list.h"
 #include "util.h"
 
-/* Minimal implementation of the dbus loop which integrates all dbus
- * events into a single epoll fd which we can triviall integrate with
- * other loops. Note that this is not used in the main systemd daemon
- * since we run a more elaborate mainloop there. */
+/* Minimal implementation of the dbus loop which hooks all dbus
+ * watches into an epoll loop owned by the caller, one fd per
+ * registration, and all timeouts into the caller's timer queue. Note
+ * that this is not used in the main systemd daemon since we run a
+ * more elaborate mainloop there. */
 
-typedef struct EpollData {
+typedef struct BusLoop BusLoop;
+typedef struct WatchFd WatchFd;
+typedef struct Watch Watch;
+typedef struct Timeout Timeout;
+
+struct BusLoop {
+        const BusLoopOps *ops;
+        void *userdata;
+
+        TimerQueue *timers;
+
+        /* fd + 1 → WatchFd */
+        Hashmap *watch_fds;
+};
+
+/* D-Bus likes to create several watches on the same fd, which epoll
+ * can't register more than once, hence group them by fd. This is what
+ * the loop owner gets to pass back to bus_loop_dispatch(). */
+struct WatchFd {
+        BusLoop *loop;
         int fd;
-        void *object;
-        bool is_timeout:1;
-        bool fd_is_dupped:1;
-} EpollData;
+        uint32_t events;
+
+        LIST_HEAD(Watch, watches);
+};
+
+struct Watch {
+        DBusWatch *watch;
+        WatchFd *watch_fd;
+
+        LIST_FIELDS(Watch, watches);
+};
+
+struct Timeout {
+        BusLoop *loop;
+        DBusTimeout *timeout;
+        Timer timer;
+};
+
+/* More watches than this on one fd are not dispatched in one go */
+#define WATCHES_PER_FD_MAX 8
+
+static uint32_t watch_fd_events(WatchFd *f) {
+        Watch *w;
+        uint32_t events = 0;
+
+        LIST_FOREACH(watches, w, f->watches)
+                events |= bus_flags_to_events(w->watch);
+
+        return events;
+}
+
+static int watch_fd_update(WatchFd *f) {
+        uint32_t events;
+        int r;
+
+        events = watch_fd_events(f);
+        if (events == f->events)
+                return 0;
+
+        r = f->loop->ops->modify_fd(f->loop->userdata, f->fd, events);
+        if (r < 0)
+                return r;
+
+        f->events = events;
+        return 0;
+}
+
+static void watch_fd_free(WatchFd *f) {
+        BusLoop *l = f->loop;
+
+        assert(!f->watches);
+
+        l->ops->remove_fd(l->userdata, f->fd);
+        hashmap_remove(l->watch_fds, INT_TO_PTR(f->fd + 1));
+        free(f);
+}
 
 static dbus_bool_t add_watch(DBusWatch *watch, void *data) {
-        _cleanup_free_ EpollData *e = NULL;
-        struct epoll_event ev = {};
+        BusLoop *l = data;
+        WatchFd *f;
+        Watch *w;
+        int fd, r;
 
         assert(watch);
+        assert(l);
 
-        e = new0(EpollData, 1);
-        if (!e)
+        w = new0(Watch, 1);
+        if (!w)
                 return FALSE;
 
-        e->fd = dbus_watch_get_unix_fd(watch);
-        e->object = watch;
-        e->is_timeout = false;
+        w->watch = watch;
 
-        ev.events = bus_flags_to_events(watch);
-        ev.data.ptr = e;
+        fd = dbus_watch_get_unix_fd(watch);
 
-        if (epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_ADD, e->fd, &ev) < 0) {
+        f = hashmap_get(l->watch_fds, INT_TO_PTR(fd + 1));
+        if (f) {
+                LIST_PREPEND(Watch, watches, f->watches, w);
+                w->watch_fd = f;
 
-                if (errno != EEXIST)
+                if (watch_fd_update(f) < 0) {
+                        LIST_REMOVE(Watch, watches, f->watches, w);
+                        free(w);
                         return FALSE;
+                }
 
-                /* Hmm, bloody D-Bus creates multiple watches on the
-                 * same fd. epoll() does not like that. As a dirty
-                 * hack we simply dup() the fd and hence get a second
-                 * one we can safely add to the epoll(). */
+                dbus_watch_set_data(watch, w, NULL);
+                return TRUE;
+        }
 
-                e->fd = dup(e->fd);
-                if (e->fd < 0)
-                        return FALSE;
+        if (hashmap_ensure_allocated(&l->watch_fds, trivial_hash_func, trivial_compare_func) < 0)
+                goto fail;
 
-                if (epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_ADD, e->fd, &ev) < 0) {
-                        close_nointr_nofail(e->fd);
-                        return FALSE;
-                }
+        f = new0(WatchFd, 1);
+        if (!f)
+                goto fail;
+
+        f->loop = l;
+        f->fd = fd;
 
-                e->fd_is_dupped = true;
+        LIST_PREPEND(Watch, watches, f->watches, w);
+        w->watch_fd = f;
+
+        f->events = watch_fd_events(f);
+
+        if (hashmap_put(l->watch_fds, INT_TO_PTR(fd + 1), f) < 0) {
+                free(f);
+                goto fail;
         }
 
-        dbus_watch_set_data(watch, e, NULL);
-        e = NULL; /* prevent freeing */
+        r = l->ops->add_fd(l->userdata, fd, f->events, f);
+        if (r < 0) {
+                hashmap_remove(l->watch_fds, INT_TO_PTR(fd + 1));
+                free(f);
+                goto fail;
+        }
 
+        dbus_watch_set_data(watch, w, NULL);
         return TRUE;
+
+fail:
+        free(w);
+        return FALSE;
 }
 
 static void remove_watch(DBusWatch *watch, void *data) {
-        _cleanup_free_ EpollData *e = NULL;
+        WatchFd *f;
+        Watch *w;
 
         assert(watch);
 
-        e = dbus_watch_get_data(watch);
-        if (!e)
+        w = dbus_watch_get_data(watch);
+        if (!w)
                 return;
 
-        assert_se(epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_DEL, e->fd, NULL) >= 0);
+        dbus_watch_set_data(watch, NULL, NULL);
 
-        if (e->fd_is_dupped)
-                close_nointr_nofail(e->fd);
+        f = w->watch_fd;
+        LIST_REMOVE(Watch, watches, f->watches, w);
+        free(w);
+
+        if (!f->watches)
+                watch_fd_free(f);
+        else
+                watch_fd_update(f);
 }
 
 static void toggle_watch(DBusWatch *watch, void *data) {
-        EpollData *e;
-        struct epoll_event ev = {};
+        Watch *w;
+        int r;
 
         assert(watch);
 
-        e = dbus_watch_get_data(watch);
-        if (!e)
+        w = dbus_watch_get_data(watch);
+        if (!w)
                 return;
 
-        ev.data.ptr = e;
-        ev.events = bus_flags_to_events(watch);
-
-        assert_se(epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_MOD, e->fd, &ev) == 0);
+        r = watch_fd_update(w->watch_fd);
+        if (r < 0)
+                log_error("Failed to update watch: %s", strerror(-r));
 }
 
-static int timeout_arm(EpollData *e) {
-        struct itimerspec its = {};
+static int timeout_arm(Timeout *t) {
+        usec_t interval;
 
-        assert(e);
-        assert(e->is_timeout);
+        assert(t);
 
-        if (dbus_timeout_get_enabled(e->object)) {
-                timespec_store(&its.it_value, dbus_timeout_get_interval(e->object) * USEC_PER_MSEC);
-                its.it_interval = its.it_value;
+        if (!dbus_timeout_get_enabled(t->timeout)) {
+                timer_stop(t->loop->timers, &t->timer);
+                return 0;
         }
 
-        if (timerfd_settime(e->fd, 0, &its, NULL) < 0)
-                return -errno;
+        /* Mostly method call timeouts, which need not be exact */
+        interval = dbus_timeout_get_interval(t->timeout) * USEC_PER_MSEC;
 
-        return 0;
+        return timer_start(t->loop->timers, &t->timer,
+                           timer_queue_now(t->loop->timers) + interval,
+                           MIN(interval / 10, USEC_PER_SEC));
 }
 
-static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data) {
-        EpollData *e;
-        struct epoll_event ev = {};
+static void timeout_expired(Timer *timer, void *userdata) {
+        Timeout *t = userdata;
+        DBusTimeout *timeout = t->timeout;
+        int r;
 
-        assert(timeout);
+        /* D-Bus timeouts repeat until disabled or removed, both of
+         * which handling it may do, hence rearm first */
+        r = timeout_arm(t);
+        if (r < 0)
+                log_error("Failed to rearm timer: %s", strerror(-r));
 
-        e = new0(EpollData, 1);
-        if (!e)
-                return FALSE;
+        dbus_timeout_handle(timeout);
+}
 
-        e->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
-        if (e->fd < 0)
-                goto fail;
+static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data) {
+        BusLoop *l = data;
+        Timeout *t;
 
-        e->object = timeout;
-        e->is_timeout = true;
+        assert(timeout);
+        assert(l);
 
-        if (timeout_arm(e) < 0)
-                goto fail;
+        t = new0(Timeout, 1);
+        if (!t)
+                return FALSE;
 
-        ev.events = EPOLLIN;
-        ev.data.ptr = e;
+        t->loop = l;
+        t->timeout = timeout;
+        timer_init(&t->timer, timeout_expired, t);
 
-        if (epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_ADD, e->fd, &ev) < 0)
-                goto fail;
+        if (timeout_arm(t) < 0) {
+                free(t);
+                return FALSE;
+        }
 
-        dbus_timeout_set_data(timeout, e, NULL);
+        dbus_timeout_set_data(timeout, t, NULL);
 
         return TRUE;
-
-fail:
-        if (e->fd >= 0)
-                close_nointr_nofail(e->fd);
-
-        free(e);
-        return FALSE;
 }
 
 static void remove_timeout(DBusTimeout *timeout, void *data) {
-        _cleanup_free_ EpollData *e = NULL;
+        Timeout *t;
 
         assert(timeout);
 
-        e = dbus_timeout_get_data(timeout);
-        if (!e)
+        t = dbus_timeout_get_data(timeout);
+        if (!t)
                 return;
 
-        assert_se(epoll_ctl(PTR_TO_INT(data), EPOLL_CTL_DEL, e->fd, NULL) >= 0);
-        close_nointr_nofail(e->fd);
+        dbus_timeout_set_data(timeout, NULL, NULL);
+
+        timer_stop(t->loop->timers, &t->timer);
+        free(t);
 }
 
 static void toggle_timeout(DBusTimeout *timeout, void *data) {
-        EpollData *e;
+        Timeout *t;
         int r;
 
         assert(timeout);
 
-        e = dbus_timeout_get_data(timeout);
-        if (!e)
+        t = dbus_timeout_get_data(timeout);
+        if (!t)
                 return;
 
-        r = timeout_arm(e);
+        r = timeout_arm(t);
         if (r < 0)
                 log_error("Failed to rearm timer: %s", strerror(-r));
 }
 
-int bus_loop_open(DBusConnection *c) {
-        int fd;
+static void bus_loop_free(void *data) {
+        BusLoop *l = data;
+
+        if (!l)
+                return;
+
+        /* All watches have been removed by now */
+        assert(hashmap_isempty(l->watch_fds));
+        hashmap_free(l->watch_fds);
+        free(l);
+}
+
+int bus_loop_open(DBusConnection *c, const BusLoopOps *ops, TimerQueue *timers, void *userdata) {
+        BusLoop *l;
 
         assert(c);
+        assert(ops);
+        assert(timers);
+
+        l = new0(BusLoop, 1);
+        if (!l)
+                return -ENOMEM;
 
-        fd = epoll_create1(EPOLL_CLOEXEC);
-        if (fd < 0)
-                return -errno;
+        l->ops = ops;
+        l->userdata = userdata;
+        l->timers = timers;
 
-        if (!dbus_connection_set_watch_functions(c, add_watch, remove_watch, toggle_watch, INT_TO_PTR(fd), NULL) ||
-            !dbus_connection_set_timeout_functions(c, add_timeout, remove_timeout, toggle_timeout, INT_TO_PTR(fd), NULL)) {
-                close_nointr_nofail(fd);
+        if (!dbus_connection_set_watch_functions(c, add_watch, remove_watch, toggle_watch, l, bus_loop_free)) {
+                bus_loop_free(l);
                 return -ENOMEM;
         }
 
-        return fd;
+        if (!dbus_connection_set_timeout_functions(c, add_timeout, remove_timeout, toggle_timeout, l, NULL)) {
+                bus_loop_close(c);
+                return -ENOMEM;
+        }
+
+        return 0;
+}
+
+void bus_loop_close(DBusConnection *c) {
+        assert(c);
+
+        /* Replacing the functions removes all watches and timeouts
+         * through the old ones, and frees the loop last */
+        dbus_connection_set_timeout_functions(c, NULL, NULL, NULL, NULL, NULL);
+        dbus_connection_set_watch_functions(c, NULL, NULL, NULL, NULL, NULL);
 }
 
-int bus_loop_dispatch(int fd) {
-        int n;
-        struct epoll_event event = {};
-        EpollData *d;
+void bus_loop_dispatch(void *object, uint32_t events) {
+        WatchFd *f = object;
+        DBusWatch *snapshot[WATCHES_PER_FD_MAX];
+        unsigned n = 0, i;
+        BusLoop *l;
+        Watch *w;
+        int fd;
 
-        assert(fd >= 0);
+        assert(f);
 
-        n = epoll_wait(fd, &event, 1, 0);
-        if (n < 0)
-                return errno == EAGAIN || errno == EINTR ? 0 : -errno;
+        l = f->loop;
+        fd = f->fd;
 
-        assert_se(d = event.data.ptr);
+        LIST_FOREACH(watches, w, f->watches)
+                if (n < ELEMENTSOF(snapshot))
+                        snapshot[n++] = w->watch;
 
-        if (d->is_timeout) {
-                DBusTimeout *t = d->object;
+        for (i = 0; i < n; i++) {
 
-                if (dbus_timeout_get_enabled(t))
-                        dbus_timeout_handle(t);
-        } else {
-                DBusWatch *w = d->object;
+                /* Handling a watch may remove any of the watches on
+                 * this fd, or the fd itself, hence look it up again */
+                f = hashmap_get(l->watch_fds, INT_TO_PTR(fd + 1));
+                if (!f)
+                        return;
 
-                if (dbus_watch_get_enabled(w))
-                        dbus_watch_handle(w, bus_events_to_flags(event.events));
-        }
+                LIST_FOREACH(watches, w, f->watches)
+                        if (w->watch == snapshot[i])
+                                break;
 
-        return 0;
+                if (w && dbus_watch_get_enabled(w->watch))
+                        dbus_watch_handle(w->watch, bus_events_to_flags(events));
+        }
 }
@@ -23,5 +23,20 @@
 
 #include <dbus/dbus.h>
 
-int bus_loop_open(DBusConnection *c);
-int bus_loop_dispatch(int fd);
+#include <stdint.h>
+
+#include "timer-queue.h"
+
+/* How the owner of the event loop watches the fds of the bus. Every
+ * event on a registered fd is to be handed to bus_loop_dispatch(),
+ * together with the object passed to add_fd(). Bus timeouts are run
+ * from the owner's timer queue. */
+typedef struct BusLoopOps {
+        int (*add_fd)(void *userdata, int fd, uint32_t events, void *object);
+        int (*modify_fd)(void *userdata, int fd, uint32_t events);
+        void (*remove_fd)(void *userdata, int fd);
+} BusLoopOps;
+
+int bus_loop_open(DBusConnection *c, const BusLoopOps *ops, TimerQueue *timers, void *userdata);
+void bus_loop_close(DBusConnection *c);
+void bus_loop_dispatch(void *object, uint32_t events);
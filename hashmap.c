@@ -27,14 +27,29 @@
 #include "util.h"
 #include "hashmap.h"
 #include "macro.h"
+#include "siphash.h"
+#include "mempool.h"
 
-#define NBUCKETS 127
+/* The index is an open addressing table using Robin Hood linear
+ * probing with backward shift deletion. It is sized to a power of
+ * two, grown when it gets 3/4 full and shrunk again when it drops
+ * below 1/8, so that maps which temporarily held a lot of entries
+ * give the memory back. Entries themselves stay on a doubly linked
+ * list, which keeps iteration in insertion order and makes it safe
+ * to remove the current entry while iterating. */
+
+#define INDEX_MIN_SHIFT 3U
 
 struct hashmap_entry {
         const void *key;
         void *value;
-        struct hashmap_entry *bucket_next, *bucket_previous;
         struct hashmap_entry *iterate_next, *iterate_previous;
+        unsigned hash;
+};
+
+struct hashmap_bucket {
+        unsigned hash;
+        struct hashmap_entry *entry;
 };
 
 struct Hashmap {
@@ -44,95 +59,48 @@ struct Hashmap {
         struct hashmap_entry *iterate_list_head, *iterate_list_tail;
         unsigned n_entries;
 
-        bool from_pool;
+        struct hashmap_bucket *buckets;
+        unsigned shift;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + ALIGN(sizeof(Hashmap))))
-
-struct pool {
-        struct pool *next;
-        unsigned n_tiles;
-        unsigned n_used;
-};
-
-static struct pool *first_hashmap_pool = NULL;
-static void *first_hashmap_tile = NULL;
-
-static struct pool *first_entry_pool = NULL;
-static void *first_entry_tile = NULL;
-
-static void* allocate_tile(struct pool **first_pool, void **first_tile, size_t tile_size) {
-        unsigned i;
-
-        if (*first_tile) {
-                void *r;
+DEFINE_MEMPOOL(hashmap_pool, Hashmap, 64);
+DEFINE_MEMPOOL(hashmap_entry_pool, struct hashmap_entry, 64);
 
-                r = *first_tile;
-                *first_tile = * (void**) (*first_tile);
-                return r;
-        }
+#ifdef VALGRIND
 
-        if (_unlikely_(!*first_pool) || _unlikely_((*first_pool)->n_used >= (*first_pool)->n_tiles)) {
-                unsigned n;
-                size_t size;
-                struct pool *p;
+__attribute__((destructor)) static void cleanup_pool(void) {
+        /* Be nice to valgrind */
 
-                n = *first_pool ? (*first_pool)->n_tiles : 0;
-                n = MAX(512U, n * 2);
-                size = PAGE_ALIGN(ALIGN(sizeof(struct pool)) + n*tile_size);
-                n = (size - ALIGN(sizeof(struct pool))) / tile_size;
+        mempool_drop(&hashmap_pool);
+        mempool_drop(&hashmap_entry_pool);
+}
 
-                p = malloc(size);
-                if (!p)
-                        return NULL;
+#endif
 
-                p->next = *first_pool;
-                p->n_tiles = n;
-                p->n_used = 0;
+static uint8_t hash_key[16];
 
-                *first_pool = p;
-        }
+void hashmap_randomize_hash_key(void) {
+        uint64_t k[2];
 
-        i = (*first_pool)->n_used++;
+        k[0] = random_ull();
+        k[1] = random_ull();
 
-        return ((uint8_t*) (*first_pool)) + ALIGN(sizeof(struct pool)) + i*tile_size;
+        memcpy(hash_key, k, sizeof(hash_key));
 }
 
-static void deallocate_tile(void **first_tile, void *p) {
-        * (void**) p = *first_tile;
-        *first_tile = p;
-}
+unsigned memory_hash_func(const void *p, size_t n) {
+        uint64_t hash;
 
-#ifdef VALGRIND
+        /* Keyed, so that clients picking session IDs or device paths
+         * cannot arrange for them to collide */
 
-static void drop_pool(struct pool *p) {
-        while (p) {
-                struct pool *n;
-                n = p->next;
-                free(p);
-                p = n;
-        }
-}
-
-__attribute__((destructor)) static void cleanup_pool(void) {
-        /* Be nice to valgrind */
+        hash = siphash13(p, n, hash_key);
 
-        drop_pool(first_hashmap_pool);
-        drop_pool(first_entry_pool);
+        return (unsigned) (hash ^ (hash >> 32));
 }
 
-#endif
-
 unsigned string_hash_func(const void *p) {
-        unsigned hash = 5381;
-        const signed char *c;
-
-        /* DJB's hash function */
-
-        for (c = p; *c; c++)
-                hash = (hash << 5) + hash + (unsigned) *c;
-
-        return hash;
+        return memory_hash_func(p, strlen(p));
 }
 
 int string_compare_func(const void *a, const void *b) {
@@ -166,35 +134,160 @@ int uint64_compare_func(const void *_a, const void *_b) {
         return a < b ? -1 : (a > b ? 1 : 0);
 }
 
-Hashmap *hashmap_new(hash_func_t hash_func, compare_func_t compare_func) {
-        bool b;
-        Hashmap *h;
-        size_t size;
+static inline unsigned n_buckets(Hashmap *h) {
+        return h->buckets ? 1U << h->shift : 0;
+}
 
-        b = is_main_thread();
+static inline unsigned bucket_index(Hashmap *h, unsigned hash) {
+        /* Fibonacci hashing: spreads the bits of weak hash functions,
+         * such as trivial_hash_func() on aligned pointers, over the
+         * whole index */
+        return (uint32_t) (hash * 2654435769U) >> (32 - h->shift);
+}
 
-        size = ALIGN(sizeof(Hashmap)) + NBUCKETS * sizeof(struct hashmap_entry*);
+static inline unsigned bucket_distance(Hashmap *h, unsigned hash, unsigned idx) {
+        return (idx - bucket_index(h, hash)) & (n_buckets(h) - 1);
+}
 
-        if (b) {
-                h = allocate_tile(&first_hashmap_pool, &first_hashmap_tile, size);
-                if (!h)
-                        return NULL;
+static void bucket_insert(Hashmap *h, struct hashmap_entry *e) {
+        struct hashmap_bucket b;
+        unsigned idx, distance = 0, mask;
 
-                memset(h, 0, size);
-        } else {
-                h = malloc0(size);
+        assert(h);
+        assert(h->buckets);
+        assert(e);
 
-                if (!h)
-                        return NULL;
+        b.hash = e->hash;
+        b.entry = e;
+
+        mask = n_buckets(h) - 1;
+
+        for (idx = bucket_index(h, b.hash);; idx = (idx + 1) & mask, distance++) {
+                struct hashmap_bucket *s = h->buckets + idx, t;
+                unsigned d;
+
+                if (!s->entry) {
+                        *s = b;
+                        return;
+                }
+
+                /* Rob the rich: the resident is closer to its home
+                 * bucket than we are, so it has to move on */
+                d = bucket_distance(h, s->hash, idx);
+                if (d < distance) {
+                        t = *s;
+                        *s = b;
+                        b = t;
+                        distance = d;
+                }
+        }
+}
+
+static void bucket_remove(Hashmap *h, struct hashmap_entry *e) {
+        unsigned idx, next, mask;
+
+        assert(h);
+        assert(h->buckets);
+        assert(e);
+
+        mask = n_buckets(h) - 1;
+
+        for (idx = bucket_index(h, e->hash); h->buckets[idx].entry != e; idx = (idx + 1) & mask)
+                assert(h->buckets[idx].entry);
+
+        /* Shift the following run back by one, so that no tombstones
+         * are needed */
+        for (next = (idx + 1) & mask;
+             h->buckets[next].entry && bucket_distance(h, h->buckets[next].hash, next) > 0;
+             idx = next, next = (next + 1) & mask)
+                h->buckets[idx] = h->buckets[next];
+
+        h->buckets[idx].entry = NULL;
+}
+
+static int resize_buckets(Hashmap *h, unsigned shift) {
+        struct hashmap_bucket *old;
+        struct hashmap_entry *e;
+
+        assert(h);
+        assert(shift >= INDEX_MIN_SHIFT && shift < 32);
+        assert(h->n_entries < (1U << shift));
+
+        old = h->buckets;
+
+        h->buckets = new0(struct hashmap_bucket, 1U << shift);
+        if (!h->buckets) {
+                h->buckets = old;
+                return -ENOMEM;
         }
 
+        h->shift = shift;
+        free(old);
+
+        for (e = h->iterate_list_head; e; e = e->iterate_next)
+                bucket_insert(h, e);
+
+        return 0;
+}
+
+static int grow_buckets(Hashmap *h) {
+        unsigned n;
+        int r;
+
+        assert(h);
+
+        n = n_buckets(h);
+        if ((h->n_entries + 1) * 4 <= n * 3)
+                return 0;
+
+        r = resize_buckets(h, n > 0 ? h->shift + 1 : INDEX_MIN_SHIFT);
+
+        /* If we cannot grow, run fuller than we'd like, as long as
+         * there is a free bucket left to terminate the probes */
+        if (r < 0 && h->n_entries + 1 < n)
+                return 0;
+
+        return r;
+}
+
+static void shrink_buckets(Hashmap *h) {
+        unsigned shift;
+
+        assert(h);
+
+        if (!h->buckets || h->shift <= INDEX_MIN_SHIFT)
+                return;
+
+        if (h->n_entries * 8 >= n_buckets(h))
+                return;
+
+        /* Leave the new index at most 1/4 full, so that we don't
+         * flip-flop between sizes */
+        for (shift = h->shift - 1; shift > INDEX_MIN_SHIFT; shift--)
+                if (h->n_entries * 4 >= (1U << (shift - 1)))
+                        break;
+
+        /* Failing to shrink is harmless, we just keep the larger
+         * index */
+        resize_buckets(h, shift);
+}
+
+Hashmap *hashmap_new(hash_func_t hash_func, compare_func_t compare_func) {
+        Hashmap *h;
+
+        h = mempool_alloc0_tile(&hashmap_pool);
+        if (!h)
+                return NULL;
+
         h->hash_func = hash_func ? hash_func : trivial_hash_func;
         h->compare_func = compare_func ? compare_func : trivial_compare_func;
 
         h->n_entries = 0;
         h->iterate_list_head = h->iterate_list_tail = NULL;
 
-        h->from_pool = b;
+        /* The index is allocated lazily on first insertion */
+        h->buckets = NULL;
+        h->shift = 0;
 
         return h;
 }
@@ -211,16 +304,19 @@ int hashmap_ensure_allocated(Hashmap **h, hash_func_t hash_func, compare_func_t
         return 0;
 }
 
-static void link_entry(Hashmap *h, struct hashmap_entry *e, unsigned hash) {
+static int link_entry(Hashmap *h, struct hashmap_entry *e, unsigned hash) {
+        int r;
+
         assert(h);
         assert(e);
 
+        r = grow_buckets(h);
+        if (r < 0)
+                return r;
+
         /* Insert into hash table */
-        e->bucket_next = BY_HASH(h)[hash];
-        e->bucket_previous = NULL;
-        if (BY_HASH(h)[hash])
-                BY_HASH(h)[hash]->bucket_previous = e;
-        BY_HASH(h)[hash] = e;
+        e->hash = hash;
+        bucket_insert(h, e);
 
         /* Insert into iteration list */
         e->iterate_previous = h->iterate_list_tail;
@@ -236,9 +332,11 @@ static void link_entry(Hashmap *h, struct hashmap_entry *e, unsigned hash) {
 
         h->n_entries++;
         assert(h->n_entries >= 1);
+
+        return 0;
 }
 
-static void unlink_entry(Hashmap *h, struct hashmap_entry *e, unsigned hash) {
+static void unlink_entry(Hashmap *h, struct hashmap_entry *e) {
         assert(h);
         assert(e);
 
@@ -253,33 +351,28 @@ static void unlink_entry(Hashmap *h, struct hashmap_entry *e, unsigned hash) {
         else
                 h->iterate_list_head = e->iterate_next;
 
-        /* Remove from hash table bucket list */
-        if (e->bucket_next)
-                e->bucket_next->bucket_previous = e->bucket_previous;
-
-        if (e->bucket_previous)
-                e->bucket_previous->bucket_next = e->bucket_next;
-        else
-                BY_HASH(h)[hash] = e->bucket_next;
+        /* Remove from hash table */
+        bucket_remove(h, e);
 
         assert(h->n_entries >= 1);
         h->n_entries--;
 }
 
-static void remove_entry(Hashmap *h, struct hashmap_entry *e) {
-        unsigned hash;
-
+static void free_entry(Hashmap *h, struct hashmap_entry *e) {
         assert(h);
         assert(e);
 
-        hash = h->hash_func(e->key) % NBUCKETS;
+        mempool_free_tile(&hashmap_entry_pool, e);
+}
 
-        unlink_entry(h, e, hash);
+static void remove_entry(Hashmap *h, struct hashmap_entry *e) {
+        assert(h);
+        assert(e);
 
-        if (h->from_pool)
-                deallocate_tile(&first_entry_tile, e);
-        else
-                free(e);
+        unlink_entry(h, e);
+        free_entry(h, e);
+
+        shrink_buckets(h);
 }
 
 void hashmap_free(Hashmap*h) {
@@ -291,10 +384,7 @@ void hashmap_free(Hashmap*h) {
 
         hashmap_clear(h);
 
-        if (h->from_pool)
-                deallocate_tile(&first_hashmap_tile, h);
-        else
-                free(h);
+        mempool_free_tile(&hashmap_pool, h);
 }
 
 void hashmap_free_free(Hashmap *h) {
@@ -321,58 +411,86 @@ void hashmap_free_free_free(Hashmap *h) {
 }
 
 void hashmap_clear(Hashmap *h) {
+        struct hashmap_entry *e, *n;
+
         if (!h)
                 return;
 
-        while (h->iterate_list_head)
-                remove_entry(h, h->iterate_list_head);
+        /* No need to maintain the index entry by entry if we drop it
+         * anyway */
+        for (e = h->iterate_list_head; e; e = n) {
+                n = e->iterate_next;
+                free_entry(h, e);
+        }
+
+        h->iterate_list_head = h->iterate_list_tail = NULL;
+        h->n_entries = 0;
+
+        free(h->buckets);
+        h->buckets = NULL;
+        h->shift = 0;
 }
 
 void hashmap_clear_free(Hashmap *h) {
-        void *p;
+        struct hashmap_entry *e;
 
         if (!h)
                 return;
 
-        while ((p = hashmap_steal_first(h)))
-                free(p);
+        for (e = h->iterate_list_head; e; e = e->iterate_next)
+                free(e->value);
+
+        hashmap_clear(h);
 }
 
 void hashmap_clear_free_free(Hashmap *h) {
+        struct hashmap_entry *e;
+
         if (!h)
                 return;
 
-        while (h->iterate_list_head) {
-                void *a, *b;
-
-                a = h->iterate_list_head->value;
-                b = (void*) h->iterate_list_head->key;
-                remove_entry(h, h->iterate_list_head);
-                free(a);
-                free(b);
+        for (e = h->iterate_list_head; e; e = e->iterate_next) {
+                free(e->value);
+                free((void*) e->key);
         }
-}
 
+        hashmap_clear(h);
+}
 
 static struct hashmap_entry *hash_scan(Hashmap *h, unsigned hash, const void *key) {
-        struct hashmap_entry *e;
+        unsigned idx, distance = 0, mask;
+
         assert(h);
-        assert(hash < NBUCKETS);
 
-        for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-                if (h->compare_func(e->key, key) == 0)
-                        return e;
+        if (!h->buckets)
+                return NULL;
 
-        return NULL;
+        mask = n_buckets(h) - 1;
+
+        for (idx = bucket_index(h, hash);; idx = (idx + 1) & mask, distance++) {
+                struct hashmap_bucket *s = h->buckets + idx;
+
+                if (!s->entry)
+                        return NULL;
+
+                /* Any entry with our hash would have displaced this
+                 * one, hence we can stop early */
+                if (bucket_distance(h, s->hash, idx) < distance)
+                        return NULL;
+
+                if (s->hash == hash && h->compare_func(s->entry->key, key) == 0)
+                        return s->entry;
+        }
 }
 
 int hashmap_put(Hashmap *h, const void *key, void *value) {
         struct hashmap_entry *e;
         unsigned hash;
+        int r;
 
         assert(h);
 
-        hash = h->hash_func(key) % NBUCKETS;
+        hash = h->hash_func(key);
 
         e = hash_scan(h, hash, key);
         if (e) {
@@ -383,30 +501,28 @@ int hashmap_put(Hashmap *h, const void *key, void *value) {
                 return -EEXIST;
         }
 
-        if (h->from_pool)
-                e = allocate_tile(&first_entry_pool, &first_entry_tile, sizeof(struct hashmap_entry));
-        else
-                e = new(struct hashmap_entry, 1);
-
+        e = mempool_alloc_tile(&hashmap_entry_pool);
         if (!e)
                 return -ENOMEM;
 
         e->key = key;
         e->value = value;
 
-        link_entry(h, e, hash);
+        r = link_entry(h, e, hash);
+        if (r < 0) {
+                free_entry(h, e);
+                return r;
+        }
 
         return 1;
 }
 
 int hashmap_replace(Hashmap *h, const void *key, void *value) {
         struct hashmap_entry *e;
-        unsigned hash;
 
         assert(h);
 
-        hash = h->hash_func(key) % NBUCKETS;
-        e = hash_scan(h, hash, key);
+        e = hash_scan(h, h->hash_func(key), key);
         if (e) {
                 e->key = key;
                 e->value = value;
@@ -418,12 +534,10 @@ int hashmap_replace(Hashmap *h, const void *key, void *value) {
 
 int hashmap_update(Hashmap *h, const void *key, void *value) {
         struct hashmap_entry *e;
-        unsigned hash;
 
         assert(h);
 
-        hash = h->hash_func(key) % NBUCKETS;
-        e = hash_scan(h, hash, key);
+        e = hash_scan(h, h->hash_func(key), key);
         if (!e)
                 return -ENOENT;
 
@@ -432,14 +546,12 @@ int hashmap_update(Hashmap *h, const void *key, void *value) {
 }
 
 void* hashmap_get(Hashmap *h, const void *key) {
-        unsigned hash;
         struct hashmap_entry *e;
 
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-        e = hash_scan(h, hash, key);
+        e = hash_scan(h, h->hash_func(key), key);
         if (!e)
                 return NULL;
 
@@ -447,14 +559,12 @@ void* hashmap_get(Hashmap *h, const void *key) {
 }
 
 void* hashmap_get2(Hashmap *h, const void *key, void **key2) {
-        unsigned hash;
         struct hashmap_entry *e;
 
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-        e = hash_scan(h, hash, key);
+        e = hash_scan(h, h->hash_func(key), key);
         if (!e)
                 return NULL;
 
@@ -465,14 +575,11 @@ void* hashmap_get2(Hashmap *h, const void *key, void **key2) {
 }
 
 bool hashmap_contains(Hashmap *h, const void *key) {
-        unsigned hash;
 
         if (!h)
                 return false;
 
-        hash = h->hash_func(key) % NBUCKETS;
-
-        if (!hash_scan(h, hash, key))
+        if (!hash_scan(h, h->hash_func(key), key))
                 return false;
 
         return true;
@@ -480,15 +587,12 @@ bool hashmap_contains(Hashmap *h, const void *key) {
 
 void* hashmap_remove(Hashmap *h, const void *key) {
         struct hashmap_entry *e;
-        unsigned hash;
         void *data;
 
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-
-        if (!(e = hash_scan(h, hash, key)))
+        if (!(e = hash_scan(h, h->hash_func(key), key)))
                 return NULL;
 
         data = e->value;
@@ -499,66 +603,62 @@ void* hashmap_remove(Hashmap *h, const void *key) {
 
 int hashmap_remove_and_put(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct hashmap_entry *e;
-        unsigned old_hash, new_hash;
+        unsigned new_hash;
 
         if (!h)
                 return -ENOENT;
 
-        old_hash = h->hash_func(old_key) % NBUCKETS;
-        if (!(e = hash_scan(h, old_hash, old_key)))
+        if (!(e = hash_scan(h, h->hash_func(old_key), old_key)))
                 return -ENOENT;
 
-        new_hash = h->hash_func(new_key) % NBUCKETS;
+        new_hash = h->hash_func(new_key);
         if (hash_scan(h, new_hash, new_key))
                 return -EEXIST;
 
-        unlink_entry(h, e, old_hash);
+        unlink_entry(h, e);
 
         e->key = new_key;
         e->value = value;
 
-        link_entry(h, e, new_hash);
+        /* The entry count is unchanged, hence this cannot fail */
+        assert_se(link_entry(h, e, new_hash) >= 0);
 
         return 0;
 }
 
 int hashmap_remove_and_replace(Hashmap *h, const void *old_key, const void *new_key, void *value) {
         struct hashmap_entry *e, *k;
-        unsigned old_hash, new_hash;
+        unsigned new_hash;
 
         if (!h)
                 return -ENOENT;
 
-        old_hash = h->hash_func(old_key) % NBUCKETS;
-        if (!(e = hash_scan(h, old_hash, old_key)))
+        if (!(e = hash_scan(h, h->hash_func(old_key), old_key)))
                 return -ENOENT;
 
-        new_hash = h->hash_func(new_key) % NBUCKETS;
+        new_hash = h->hash_func(new_key);
 
         if ((k = hash_scan(h, new_hash, new_key)))
                 if (e != k)
                         remove_entry(h, k);
 
-        unlink_entry(h, e, old_hash);
+        unlink_entry(h, e);
 
         e->key = new_key;
         e->value = value;
 
-        link_entry(h, e, new_hash);
+        assert_se(link_entry(h, e, new_hash) >= 0);
 
         return 0;
 }
 
 void* hashmap_remove_value(Hashmap *h, const void *key, void *value) {
         struct hashmap_entry *e;
-        unsigned hash;
 
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-
-        if (!(e = hash_scan(h, hash, key)))
+        if (!(e = hash_scan(h, h->hash_func(key), key)))
                 return NULL;
 
         if (e->value != value)
@@ -640,15 +740,12 @@ at_beginning:
 }
 
 void *hashmap_iterate_skip(Hashmap *h, const void *key, Iterator *i) {
-        unsigned hash;
         struct hashmap_entry *e;
 
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-
-        if (!(e = hash_scan(h, hash, key)))
+        if (!(e = hash_scan(h, h->hash_func(key), key)))
                 return NULL;
 
         *i = (Iterator) e;
@@ -760,47 +857,57 @@ void hashmap_move(Hashmap *h, Hashmap *other) {
         assert(h);
 
         /* The same as hashmap_merge(), but every new item from other
-         * is moved to h. This function is guaranteed to succeed. */
+         * is moved to h. This function is guaranteed to succeed,
+         * except that items stay in other if h's index cannot grow. */
 
         if (!other)
                 return;
 
         for (e = other->iterate_list_head; e; e = n) {
-                unsigned h_hash, other_hash;
+                unsigned h_hash;
 
                 n = e->iterate_next;
 
-                h_hash = h->hash_func(e->key) % NBUCKETS;
+                h_hash = h->hash_func(e->key);
 
                 if (hash_scan(h, h_hash, e->key))
                         continue;
 
-                other_hash = other->hash_func(e->key) % NBUCKETS;
+                if (grow_buckets(h) < 0)
+                        break;
 
-                unlink_entry(other, e, other_hash);
-                link_entry(h, e, h_hash);
+                unlink_entry(other, e);
+                assert_se(link_entry(h, e, h_hash) >= 0);
         }
+
+        shrink_buckets(other);
 }
 
 int hashmap_move_one(Hashmap *h, Hashmap *other, const void *key) {
-        unsigned h_hash, other_hash;
+        unsigned h_hash;
         struct hashmap_entry *e;
+        int r;
 
         if (!other)
                 return 0;
 
         assert(h);
 
-        h_hash = h->hash_func(key) % NBUCKETS;
+        h_hash = h->hash_func(key);
         if (hash_scan(h, h_hash, key))
                 return -EEXIST;
 
-        other_hash = other->hash_func(key) % NBUCKETS;
-        if (!(e = hash_scan(other, other_hash, key)))
+        if (!(e = hash_scan(other, other->hash_func(key), key)))
                 return -ENOENT;
 
-        unlink_entry(other, e, other_hash);
-        link_entry(h, e, h_hash);
+        r = grow_buckets(h);
+        if (r < 0)
+                return r;
+
+        unlink_entry(other, e);
+        assert_se(link_entry(h, e, h_hash) >= 0);
+
+        shrink_buckets(other);
 
         return 0;
 }
@@ -840,7 +947,6 @@ char **hashmap_get_strv(Hashmap *h) {
 }
 
 void *hashmap_next(Hashmap *h, const void *key) {
-        unsigned hash;
         struct hashmap_entry *e;
 
         assert(h);
@@ -849,8 +955,7 @@ void *hashmap_next(Hashmap *h, const void *key) {
         if (!h)
                 return NULL;
 
-        hash = h->hash_func(key) % NBUCKETS;
-        e = hash_scan(h, hash, key);
+        e = hash_scan(h, h->hash_func(key), key);
         if (!e)
                 return NULL;
 
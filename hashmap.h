@@ -40,6 +40,15 @@ typedef _IteratorStruct* Iterator;
 typedef unsigned (*hash_func_t)(const void *p);
 typedef int (*compare_func_t)(const void *a, const void *b);
 
+/* Picks a new random key for string_hash_func() and
+ * memory_hash_func(). Must be called before any hashmap with string
+ * keys is populated. */
+void hashmap_randomize_hash_key(void);
+
+/* Building block for hash functions of keys that are not NUL
+ * terminated strings, hashes the same as string_hash_func() */
+unsigned memory_hash_func(const void *p, size_t n) _pure_;
+
 unsigned string_hash_func(const void *p) _pure_;
 int string_compare_func(const void *a, const void *b) _pure_;
 
@@ -0,0 +1,77 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <string.h>
+
+#include "util.h"
+#include "histogram.h"
+
+void histogram_reset(Histogram *h) {
+        assert(h);
+
+        zero(*h);
+}
+
+uint64_t histogram_bucket_lowest(unsigned b) {
+        unsigned e;
+
+        assert(b < HISTOGRAM_BUCKETS);
+
+        if (b < HISTOGRAM_SUB_BUCKETS)
+                return b;
+
+        e = b / HISTOGRAM_SUB_BUCKETS - 1;
+
+        return (uint64_t) (HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS) << e;
+}
+
+uint64_t histogram_bucket_highest(unsigned b) {
+        assert(b < HISTOGRAM_BUCKETS);
+
+        if (b == HISTOGRAM_BUCKETS - 1)
+                return (uint64_t) -1;
+
+        return histogram_bucket_lowest(b + 1) - 1;
+}
+
+uint64_t histogram_percentile(const Histogram *h, unsigned permille) {
+        uint64_t rank, seen = 0;
+        unsigned b;
+
+        assert(h);
+        assert(permille <= 1000);
+
+        if (h->count == 0)
+                return 0;
+
+        /* The rank of the value we look for, rounded up */
+        rank = (h->count * permille + 999) / 1000;
+        if (rank == 0)
+                rank = 1;
+
+        for (b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                seen += h->buckets[b];
+
+                if (seen >= rank)
+                        return MIN(histogram_bucket_highest(b), h->max);
+        }
+
+        return h->max;
+}
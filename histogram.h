@@ -0,0 +1,82 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdint.h>
+
+#include "macro.h"
+
+/* Log-linear latency histogram in the style of HdrHistogram. Values
+ * are bucketed by their highest set bit and the HISTOGRAM_SUB_BITS
+ * bits below it, so every bucket is at most 1/2^HISTOGRAM_SUB_BITS
+ * of its value wide. Recording is a handful of arithmetic
+ * instructions and never allocates. */
+
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1U << HISTOGRAM_SUB_BITS)
+
+/* Values of 2^HISTOGRAM_MAX_BITS and above all end up in the last
+ * bucket, for microseconds that is a bit over an hour */
+#define HISTOGRAM_MAX_BITS 32
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct Histogram {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+        uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+static inline unsigned histogram_bucket(uint64_t v) {
+        unsigned e;
+
+        if (v < HISTOGRAM_SUB_BUCKETS)
+                return (unsigned) v;
+
+        e = 63 - __builtin_clzll(v);
+        if (e >= HISTOGRAM_MAX_BITS)
+                return HISTOGRAM_BUCKETS - 1;
+
+        return (e - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+                (unsigned) ((v >> (e - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+static inline void histogram_record(Histogram *h, uint64_t v) {
+        if (h->count == 0 || v < h->min)
+                h->min = v;
+        if (v > h->max)
+                h->max = v;
+
+        h->count++;
+        h->sum += v;
+        h->buckets[histogram_bucket(v)]++;
+}
+
+void histogram_reset(Histogram *h);
+
+/* Smallest and largest value that fall into bucket b */
+uint64_t histogram_bucket_lowest(unsigned b) _const_;
+uint64_t histogram_bucket_highest(unsigned b) _const_;
+
+/* Upper bound of the value below which the given permille of the
+ * recorded values lie, clamped to the largest value recorded */
+uint64_t histogram_percentile(const Histogram *h, unsigned permille) _pure_;
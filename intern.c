@@ -0,0 +1,229 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "util.h"
+#include "strv.h"
+#include "intern.h"
+
+typedef struct InternedString {
+        unsigned n_ref;
+        char str[];
+} InternedString;
+
+typedef struct InternedStrv {
+        unsigned n_ref;
+        char *strv[];
+} InternedStrv;
+
+#define INTERNED_STRING(s) ((InternedString*) ((char*) (s) - offsetof(InternedString, str)))
+#define INTERNED_STRV(l) ((InternedStrv*) ((char*) (l) - offsetof(InternedStrv, strv)))
+
+/* Interned lists consist of interned strings only, hence it is
+ * sufficient to hash and compare the element pointers */
+static unsigned strv_pointer_hash_func(const void *p) {
+        char * const *l = p;
+
+        return memory_hash_func(l, strv_length((char**) l) * sizeof(char*));
+}
+
+static int strv_pointer_compare_func(const void *a, const void *b) {
+        char * const *x = a, * const *y = b;
+
+        for (;; x++, y++) {
+                if (*x != *y)
+                        return *x < *y ? -1 : 1;
+
+                if (!*x)
+                        return 0;
+        }
+}
+
+void intern_table_done(InternTable *t) {
+        void *e;
+
+        assert(t);
+
+        /* Everything should have been unreferenced by now, but
+         * don't leak if it wasn't */
+        while ((e = hashmap_steal_first(t->strvs)))
+                free(e);
+
+        while ((e = hashmap_steal_first(t->strings)))
+                free(e);
+
+        hashmap_free(t->strvs);
+        hashmap_free(t->strings);
+        t->strvs = t->strings = NULL;
+}
+
+int intern_string(InternTable *t, const char *s, const char **ret) {
+        InternedString *e;
+        size_t l;
+        int r;
+
+        assert(t);
+        assert(s);
+        assert(ret);
+
+        e = hashmap_get(t->strings, s);
+        if (e) {
+                e->n_ref++;
+                *ret = e->str;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&t->strings, string_hash_func, string_compare_func);
+        if (r < 0)
+                return r;
+
+        l = strlen(s);
+        e = malloc(offsetof(InternedString, str) + l + 1);
+        if (!e)
+                return -ENOMEM;
+
+        e->n_ref = 1;
+        memcpy(e->str, s, l + 1);
+
+        r = hashmap_put(t->strings, e->str, e);
+        if (r < 0) {
+                free(e);
+                return r;
+        }
+
+        *ret = e->str;
+        return 0;
+}
+
+void intern_string_unref(InternTable *t, const char *s) {
+        InternedString *e;
+
+        assert(t);
+
+        if (!s)
+                return;
+
+        e = INTERNED_STRING(s);
+        assert(e->n_ref > 0);
+
+        if (--e->n_ref > 0)
+                return;
+
+        hashmap_remove(t->strings, e->str);
+        free(e);
+}
+
+int intern_strv(InternTable *t, char **l, char ***ret) {
+        InternedStrv *e, *found;
+        unsigned n, i;
+        char **k;
+        int r;
+
+        assert(t);
+        assert(ret);
+
+        if (strv_isempty(l)) {
+                *ret = NULL;
+                return 0;
+        }
+
+        r = hashmap_ensure_allocated(&t->strvs, strv_pointer_hash_func, strv_pointer_compare_func);
+        if (r < 0)
+                return r;
+
+        n = strv_length(l);
+        e = malloc(offsetof(InternedStrv, strv) + (n + 1) * sizeof(char*));
+        if (!e)
+                return -ENOMEM;
+
+        e->n_ref = 1;
+
+        i = 0;
+        STRV_FOREACH(k, l) {
+                r = intern_string(t, *k, (const char**) &e->strv[i]);
+                if (r < 0)
+                        goto fail;
+
+                i++;
+        }
+        e->strv[i] = NULL;
+
+        found = hashmap_get(t->strvs, e->strv);
+        if (found) {
+                found->n_ref++;
+                *ret = found->strv;
+
+                intern_strv_unref(t, e->strv);
+                return 0;
+        }
+
+        r = hashmap_put(t->strvs, e->strv, e);
+        if (r < 0)
+                goto fail;
+
+        *ret = e->strv;
+        return 0;
+
+fail:
+        while (i > 0)
+                intern_string_unref(t, e->strv[--i]);
+
+        free(e);
+        return r;
+}
+
+void intern_strv_unref(InternTable *t, char **l) {
+        InternedStrv *e;
+        char **k;
+
+        assert(t);
+
+        if (!l)
+                return;
+
+        e = INTERNED_STRV(l);
+        assert(e->n_ref > 0);
+
+        if (--e->n_ref > 0)
+                return;
+
+        /* Only drop the entry if it is the one in the table, a
+         * freshly built duplicate never made it there */
+        if (hashmap_get(t->strvs, e->strv) == e)
+                hashmap_remove(t->strvs, e->strv);
+
+        STRV_FOREACH(k, e->strv)
+                intern_string_unref(t, *k);
+
+        free(e);
+}
+
+bool intern_strv_contains(char **l, const char *s) {
+        char **k;
+
+        STRV_FOREACH(k, l)
+                if (*k == s)
+                        return true;
+
+        return false;
+}
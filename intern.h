@@ -0,0 +1,49 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdbool.h>
+
+#include "hashmap.h"
+
+/* Interning of immutable, refcounted strings and string lists. Equal
+ * values share one copy, hence interned strings from the same table
+ * may be compared by pointer. Interned lists hold interned strings
+ * only, and equal lists are shared, too. Neither may be modified or
+ * freed by the caller, drop references with the _unref() calls
+ * instead. */
+
+typedef struct InternTable {
+        Hashmap *strings;
+        Hashmap *strvs;
+} InternTable;
+
+void intern_table_done(InternTable *t);
+
+int intern_string(InternTable *t, const char *s, const char **ret);
+void intern_string_unref(InternTable *t, const char *s);
+
+/* An empty or NULL list is interned as NULL */
+int intern_strv(InternTable *t, char **l, char ***ret);
+void intern_strv_unref(InternTable *t, char **l);
+
+/* Like strv_contains(), but for interned l and s of the same table */
+bool intern_strv_contains(char **l, const char *s) _pure_;
@@ -56,7 +56,6 @@ int manager_handle_action(
                 [HANDLE_HYBRID_SLEEP] = SPECIAL_HYBRID_SLEEP_TARGET
         };
 
-        DBusError error;
         int r;
         InhibitWhat inhibit_operation;
         bool supported;
@@ -124,11 +123,9 @@ int manager_handle_action(
 
         log_info("%s", message_table[handle]);
 
-        dbus_error_init(&error);
-        r = bus_manager_shutdown_or_sleep_now_or_later(m, target_table[handle], inhibit_operation, &error);
+        r = bus_manager_shutdown_or_sleep_now_or_later(m, target_table[handle], inhibit_operation, NULL);
         if (r < 0) {
-                log_error("Failed to execute operation: %s", bus_error_message(&error));
-                dbus_error_free(&error);
+                log_error("Failed to execute operation: %s", strerror(-r));
                 return r;
         }
 
@@ -34,6 +34,9 @@
 #include "special.h"
 #include "dbus-common.h"
 #include "sd-messages.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(button_pool, Button, 64);
 
 Button* button_new(Manager *m, const char *name) {
         Button *b;
@@ -41,19 +44,19 @@ Button* button_new(Manager *m, const char *name) {
         assert(m);
         assert(name);
 
-        b = new0(Button, 1);
+        b = mempool_alloc0_tile(&button_pool);
         if (!b)
                 return NULL;
 
         b->name = strdup(name);
         if (!b->name) {
-                free(b);
+                mempool_free_tile(&button_pool, b);
                 return NULL;
         }
 
         if (hashmap_put(m->buttons, b->name, b) < 0) {
                 free(b->name);
-                free(b);
+                mempool_free_tile(&button_pool, b);
                 return NULL;
         }
 
@@ -69,7 +72,7 @@ void button_free(Button *b) {
         hashmap_remove(b->manager->buttons, b->name);
 
         if (b->fd >= 0) {
-                hashmap_remove(b->manager->button_fds, INT_TO_PTR(b->fd + 1));
+                manager_remove_fd_object(b->manager, b->fd);
                 assert_se(epoll_ctl(b->manager->epoll_fd, EPOLL_CTL_DEL, b->fd, NULL) == 0);
 
                 /* If the device has been unplugged close() returns
@@ -80,7 +83,7 @@ void button_free(Button *b) {
 
         free(b->name);
         free(b->seat);
-        free(b);
+        mempool_free_tile(&button_pool, b);
 }
 
 int button_set_seat(Button *b, const char *sn) {
@@ -107,6 +110,7 @@ int button_open(Button *b) {
         assert(b);
 
         if (b->fd >= 0) {
+                manager_remove_fd_object(b->manager, b->fd);
                 close(b->fd);
                 b->fd = -1;
         }
@@ -138,9 +142,9 @@ int button_open(Button *b) {
                 goto fail;
         }
 
-        r = hashmap_put(b->manager->button_fds, INT_TO_PTR(b->fd + 1), b);
+        r = manager_add_fd_object(b->manager, b->fd, FD_OBJECT_BUTTON, b);
         if (r < 0) {
-                log_error("Failed to add to hash map: %s", strerror(-r));
+                log_error("Failed to add to fd table: %s", strerror(-r));
                 assert_se(epoll_ctl(b->manager->epoll_fd, EPOLL_CTL_DEL, b->fd, NULL) == 0);
                 goto fail;
         }
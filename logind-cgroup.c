@@ -0,0 +1,261 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+
+#include "logind-cgroup.h"
+#include "util.h"
+
+static unsigned component_hash_func(const void *p) {
+        const CGroupComponent *c = p;
+
+        return memory_hash_func(c->name, c->length);
+}
+
+static int component_compare_func(const void *a, const void *b) {
+        const CGroupComponent *x = a, *y = b;
+        int r;
+
+        r = memcmp(x->name, y->name, MIN(x->length, y->length));
+        if (r != 0)
+                return r;
+
+        return x->length < y->length ? -1 : (x->length > y->length ? 1 : 0);
+}
+
+static CGroupNode *cgroup_node_new(CGroupNode *parent, const char *name, size_t length) {
+        CGroupNode *n;
+
+        n = malloc0(sizeof(CGroupNode) + length + 1);
+        if (!n)
+                return NULL;
+
+        memcpy(n->name, name, length);
+        n->component.name = n->name;
+        n->component.length = length;
+
+        if (parent) {
+                if (hashmap_ensure_allocated(&parent->children, component_hash_func, component_compare_func) < 0 ||
+                    hashmap_put(parent->children, &n->component, n) < 0) {
+                        free(n);
+                        return NULL;
+                }
+
+                n->parent = parent;
+        }
+
+        return n;
+}
+
+void cgroup_node_free(CGroupNode *n) {
+        CGroupNode *c;
+
+        if (!n)
+                return;
+
+        while ((c = hashmap_first(n->children)))
+                cgroup_node_free(c);
+
+        hashmap_free(n->children);
+
+        if (n->parent)
+                hashmap_remove(n->parent->children, &n->component);
+
+        free(n);
+}
+
+static void cgroup_node_prune(CGroupNode *n) {
+
+        /* Drops the node and its ancestors as long as nobody needs
+         * them anymore. The root stays around. */
+
+        while (n && n->parent && !n->session && !n->user && hashmap_isempty(n->children)) {
+                CGroupNode *p = n->parent;
+
+                cgroup_node_free(n);
+                n = p;
+        }
+}
+
+static const char *next_component(const char *p, CGroupComponent *c) {
+        const char *e;
+
+        assert(p);
+        assert(c);
+
+        e = strchrnul(p, '/');
+
+        c->name = p;
+        c->length = e - p;
+
+        return *e ? e + 1 : NULL;
+}
+
+static CGroupNode *cgroup_node_find(Manager *m, const char *cgroup, bool create) {
+        CGroupNode *n;
+        const char *p;
+
+        assert(m);
+        assert(cgroup);
+
+        if (cgroup[0] != '/')
+                return NULL;
+
+        if (!m->cgroup_root) {
+                if (!create)
+                        return NULL;
+
+                m->cgroup_root = cgroup_node_new(NULL, "", 0);
+                if (!m->cgroup_root)
+                        return NULL;
+        }
+
+        n = m->cgroup_root;
+
+        for (p = cgroup[1] ? cgroup + 1 : NULL; p; ) {
+                CGroupComponent c;
+                CGroupNode *k;
+
+                p = next_component(p, &c);
+
+                k = hashmap_get(n->children, &c);
+                if (!k) {
+                        if (!create)
+                                return NULL;
+
+                        k = cgroup_node_new(n, c.name, c.length);
+                        if (!k) {
+                                cgroup_node_prune(n);
+                                return NULL;
+                        }
+                }
+
+                n = k;
+        }
+
+        return n;
+}
+
+int manager_cgroup_map_session(Manager *m, const char *cgroup, Session *s) {
+        CGroupNode *n;
+
+        assert(m);
+        assert(cgroup);
+        assert(s);
+
+        n = cgroup_node_find(m, cgroup, true);
+        if (!n)
+                return cgroup[0] == '/' ? -ENOMEM : -EINVAL;
+
+        if (n->session && n->session != s)
+                return -EEXIST;
+
+        n->session = s;
+        return 0;
+}
+
+void manager_cgroup_unmap_session(Manager *m, const char *cgroup, Session *s) {
+        CGroupNode *n;
+
+        assert(m);
+        assert(cgroup);
+        assert(s);
+
+        n = cgroup_node_find(m, cgroup, false);
+        if (!n || n->session != s)
+                return;
+
+        n->session = NULL;
+        cgroup_node_prune(n);
+}
+
+int manager_cgroup_map_user(Manager *m, const char *cgroup, User *u) {
+        CGroupNode *n;
+
+        assert(m);
+        assert(cgroup);
+        assert(u);
+
+        n = cgroup_node_find(m, cgroup, true);
+        if (!n)
+                return cgroup[0] == '/' ? -ENOMEM : -EINVAL;
+
+        if (n->user && n->user != u)
+                return -EEXIST;
+
+        n->user = u;
+        return 0;
+}
+
+void manager_cgroup_unmap_user(Manager *m, const char *cgroup, User *u) {
+        CGroupNode *n;
+
+        assert(m);
+        assert(cgroup);
+        assert(u);
+
+        n = cgroup_node_find(m, cgroup, false);
+        if (!n || n->user != u)
+                return;
+
+        n->user = NULL;
+        cgroup_node_prune(n);
+}
+
+void manager_cgroup_lookup(Manager *m, const char *cgroup, Session **session, User **user) {
+        CGroupNode *n;
+        const char *p;
+        Session *s = NULL;
+        User *u = NULL;
+
+        assert(m);
+        assert(cgroup);
+
+        /* Walks down as far as the path matches, remembering the
+         * deepest session and user on the way */
+
+        if (cgroup[0] != '/')
+                goto finish;
+
+        n = m->cgroup_root;
+
+        for (p = cgroup[1] ? cgroup + 1 : NULL; n; ) {
+                CGroupComponent c;
+
+                if (n->session)
+                        s = n->session;
+                if (n->user)
+                        u = n->user;
+
+                if (!p)
+                        break;
+
+                p = next_component(p, &c);
+                n = hashmap_get(n->children, &c);
+        }
+
+finish:
+        if (session)
+                *session = s;
+        if (user)
+                *user = u;
+}
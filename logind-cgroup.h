@@ -0,0 +1,59 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+typedef struct CGroupNode CGroupNode;
+
+#include "hashmap.h"
+#include "logind.h"
+#include "logind-session.h"
+#include "logind-user.h"
+
+/* Index of the cgroups of sessions and users, as a tree of path
+ * components. A single walk down the tree yields the session and the
+ * user owning any cgroup path, i.e. the longest registered prefix,
+ * without copying or rehashing the path for every level. */
+
+typedef struct CGroupComponent {
+        const char *name;
+        size_t length;
+} CGroupComponent;
+
+struct CGroupNode {
+        CGroupComponent component;
+
+        CGroupNode *parent;
+        Hashmap *children;
+
+        Session *session;
+        User *user;
+
+        char name[];
+};
+
+void cgroup_node_free(CGroupNode *n);
+
+int manager_cgroup_map_session(Manager *m, const char *cgroup, Session *s);
+void manager_cgroup_unmap_session(Manager *m, const char *cgroup, Session *s);
+int manager_cgroup_map_user(Manager *m, const char *cgroup, User *u);
+void manager_cgroup_unmap_user(Manager *m, const char *cgroup, User *u);
+
+void manager_cgroup_lookup(Manager *m, const char *cgroup, Session **session, User **user);
@@ -26,6 +26,8 @@
 
 #include "logind.h"
 #include "dbus-common.h"
+#include "logind-method.h"
+#include "logind-list.h"
 #include "strv.h"
 #include "mkdir.h"
 #include "path-util.h"
@@ -64,6 +66,32 @@
         "  <method name=\"ListSeats\">\n"                               \
         "   <arg name=\"seats\" type=\"a(so)\" direction=\"out\"/>\n"   \
         "  </method>\n"                                                 \
+        "  <method name=\"ListSessionsEx\">\n"                          \
+        "   <arg name=\"filter\" type=\"a{sv}\" direction=\"in\"/>\n"   \
+        "   <arg name=\"cursor\" type=\"s\" direction=\"in\"/>\n"       \
+        "   <arg name=\"limit\" type=\"u\" direction=\"in\"/>\n"        \
+        "   <arg name=\"sessions\" type=\"a(susso)\" direction=\"out\"/>\n" \
+        "   <arg name=\"next_cursor\" type=\"s\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
+        "  <method name=\"ListUsersEx\">\n"                             \
+        "   <arg name=\"filter\" type=\"a{sv}\" direction=\"in\"/>\n"   \
+        "   <arg name=\"cursor\" type=\"s\" direction=\"in\"/>\n"       \
+        "   <arg name=\"limit\" type=\"u\" direction=\"in\"/>\n"        \
+        "   <arg name=\"users\" type=\"a(uso)\" direction=\"out\"/>\n"  \
+        "   <arg name=\"next_cursor\" type=\"s\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
+        "  <method name=\"ListSeatsEx\">\n"                             \
+        "   <arg name=\"filter\" type=\"a{sv}\" direction=\"in\"/>\n"   \
+        "   <arg name=\"cursor\" type=\"s\" direction=\"in\"/>\n"       \
+        "   <arg name=\"limit\" type=\"u\" direction=\"in\"/>\n"        \
+        "   <arg name=\"seats\" type=\"a(so)\" direction=\"out\"/>\n"   \
+        "   <arg name=\"next_cursor\" type=\"s\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
+        "  <method name=\"GetObjectProperties\">\n"                     \
+        "   <arg name=\"kind\" type=\"s\" direction=\"in\"/>\n"         \
+        "   <arg name=\"filter\" type=\"a{sv}\" direction=\"in\"/>\n"   \
+        "   <arg name=\"objects\" type=\"a{oa{sa{sv}}}\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
         "  <method name=\"CreateSession\">\n"                           \
         "   <arg name=\"uid\" type=\"u\" direction=\"in\"/>\n"          \
         "   <arg name=\"leader\" type=\"u\" direction=\"in\"/>\n"       \
@@ -177,6 +205,13 @@
         "  <method name=\"ListInhibitors\">\n"                          \
         "   <arg name=\"inhibitors\" type=\"a(ssssuu)\" direction=\"out\"/>\n" \
         "  </method>\n"                                                 \
+        "  <method name=\"ListInhibitorsEx\">\n"                        \
+        "   <arg name=\"filter\" type=\"a{sv}\" direction=\"in\"/>\n"   \
+        "   <arg name=\"cursor\" type=\"s\" direction=\"in\"/>\n"       \
+        "   <arg name=\"limit\" type=\"u\" direction=\"in\"/>\n"        \
+        "   <arg name=\"inhibitors\" type=\"a(ssssuu)\" direction=\"out\"/>\n" \
+        "   <arg name=\"next_cursor\" type=\"s\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
         "  <signal name=\"SessionNew\">\n"                              \
         "   <arg name=\"id\" type=\"s\"/>\n"                            \
         "   <arg name=\"path\" type=\"o\"/>\n"                          \
@@ -228,12 +263,33 @@
         "  <property name=\"IdleActionUSec\" type=\"t\" access=\"read\"/>\n" \
         "  <property name=\"PreparingForShutdown\" type=\"b\" access=\"read\"/>\n" \
         "  <property name=\"PreparingForSleep\" type=\"b\" access=\"read\"/>\n" \
+        "  <property name=\"EventLoopWakeups\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"EventLoopEvents\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"GCQueueLength\" type=\"u\" access=\"read\"/>\n" \
+        "  <property name=\"GCUSec\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"PolkitCacheHits\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"PolkitCacheMisses\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"CredsCacheHits\" type=\"t\" access=\"read\"/>\n" \
+        "  <property name=\"CredsCacheMisses\" type=\"t\" access=\"read\"/>\n" \
+        " </interface>\n"
+
+#define BUS_STATS_INTERFACE                                             \
+        " <interface name=\"org.freedesktop.login1.Stats\">\n"          \
+        "  <method name=\"GetStats\">\n"                                \
+        "   <arg name=\"since\" type=\"t\" direction=\"out\"/>\n"        \
+        "   <arg name=\"sources\" type=\"a(stttttta(tt))\" direction=\"out\"/>\n" \
+        "   <arg name=\"methods\" type=\"a(stttttta(tt))\" direction=\"out\"/>\n" \
+        "  </method>\n"                                                 \
+        "  <method name=\"ResetStats\">\n"                              \
+        "   <arg name=\"interactive\" type=\"b\" direction=\"in\"/>\n"  \
+        "  </method>\n"                                                 \
         " </interface>\n"
 
 #define INTROSPECTION_BEGIN                                             \
         DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE                       \
         "<node>\n"                                                      \
         BUS_MANAGER_INTERFACE                                           \
+        BUS_STATS_INTERFACE                                             \
         BUS_PROPERTIES_INTERFACE                                        \
         BUS_PEER_INTERFACE                                              \
         BUS_INTROSPECTABLE_INTERFACE
@@ -243,7 +299,8 @@
 
 #define INTERFACES_LIST                              \
         BUS_GENERIC_INTERFACES_LIST                  \
-        "org.freedesktop.login1.Manager\0"
+        "org.freedesktop.login1.Manager\0"            \
+        "org.freedesktop.login1.Stats\0"
 
 static int bus_manager_append_idle_hint(DBusMessageIter *i, const char *property, void *data) {
         Manager *m = data;
@@ -308,6 +365,22 @@ static int bus_manager_append_preparing(DBusMessageIter *i, const char *property
         return 0;
 }
 
+static int bus_manager_append_gc_queue_length(DBusMessageIter *i, const char *property, void *data) {
+        Manager *m = data;
+        uint32_t u;
+
+        assert(i);
+        assert(property);
+        assert(m);
+
+        u = manager_gc_queue_length(m);
+
+        if (!dbus_message_iter_append_basic(i, DBUS_TYPE_UINT32, &u))
+                return -ENOMEM;
+
+        return 0;
+}
+
 static int bus_manager_create_session(Manager *m, DBusMessage *message, DBusMessage **_reply) {
         const char *type, *class, *cseat, *tty, *display, *remote_user, *remote_host, *service;
         uint32_t uid, leader, audit_id = 0;
@@ -613,49 +686,33 @@ static int bus_manager_create_session(Manager *m, DBusMessage *message, DBusMess
         session->kill_processes = kill_processes;
         session->vtnr = vtnr;
 
-        session->controllers = cg_shorten_controllers(controllers);
-        session->reset_controllers = cg_shorten_controllers(reset_controllers);
-        controllers = reset_controllers = NULL;
+        r = intern_strv(&m->interned, cg_shorten_controllers(controllers), &session->controllers);
+        if (r < 0)
+                goto fail;
 
-        if (!isempty(tty)) {
-                session->tty = strdup(tty);
-                if (!session->tty) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        r = intern_strv(&m->interned, cg_shorten_controllers(reset_controllers), &session->reset_controllers);
+        if (r < 0)
+                goto fail;
 
-        if (!isempty(display)) {
-                session->display = strdup(display);
-                if (!session->display) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        r = session_set_string(session, &session->tty, tty);
+        if (r < 0)
+                goto fail;
 
-        if (!isempty(remote_user)) {
-                session->remote_user = strdup(remote_user);
-                if (!session->remote_user) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        r = session_set_string(session, &session->display, display);
+        if (r < 0)
+                goto fail;
 
-        if (!isempty(remote_host)) {
-                session->remote_host = strdup(remote_host);
-                if (!session->remote_host) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        r = session_set_string(session, &session->remote_user, remote_user);
+        if (r < 0)
+                goto fail;
 
-        if (!isempty(service)) {
-                session->service = strdup(service);
-                if (!session->service) {
-                        r = -ENOMEM;
-                        goto fail;
-                }
-        }
+        r = session_set_string(session, &session->remote_host, remote_host);
+        if (r < 0)
+                goto fail;
+
+        r = session_set_string(session, &session->service, service);
+        if (r < 0)
+                goto fail;
 
         fifo_fd = session_create_fifo(session);
         if (fifo_fd < 0) {
@@ -718,6 +775,43 @@ fail:
         return r;
 }
 
+static DBusHandlerResult manager_message_handler(
+                DBusConnection *connection,
+                DBusMessage *message,
+                void *userdata);
+
+/* Looking up the caller's credentials and authorization checks may
+ * need a roundtrip. In that case -EINPROGRESS is returned, no reply
+ * should be sent, and the method is dispatched again once the answer
+ * is in. */
+static int manager_get_creds(
+                Manager *m,
+                DBusConnection *connection,
+                DBusMessage *message,
+                const BusCreds **creds) {
+
+        return bus_creds_get_async(&m->creds, connection, message, creds, manager_message_handler, m);
+}
+
+static int manager_verify_polkit(
+                Manager *m,
+                DBusConnection *connection,
+                DBusMessage *message,
+                const char *action,
+                bool interactive,
+                bool *challenge) {
+
+        const BusCreds *creds;
+        int r;
+
+        r = manager_get_creds(m, connection, message, &creds);
+        if (r < 0)
+                return r;
+
+        return verify_polkit_async(connection, message, action, interactive, challenge, creds,
+                                   &m->polkit_registry, &m->polkit_cache, manager_message_handler, m);
+}
+
 static int bus_manager_inhibit(
                 Manager *m,
                 DBusConnection *connection,
@@ -728,10 +822,9 @@ static int bus_manager_inhibit(
         Inhibitor *i = NULL;
         char *id = NULL;
         const char *who, *why, *what, *mode;
-        pid_t pid;
+        const BusCreds *creds;
         InhibitWhat w;
         InhibitMode mm;
-        unsigned long ul;
         int r, fifo_fd = -1;
         _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
 
@@ -780,29 +873,21 @@ static int bus_manager_inhibit(
                 goto fail;
         }
 
-        r = verify_polkit(connection, message,
-                          w == INHIBIT_SHUTDOWN             ? (mm == INHIBIT_BLOCK ? "org.freedesktop.login1.inhibit-block-shutdown" : "org.freedesktop.login1.inhibit-delay-shutdown") :
-                          w == INHIBIT_SLEEP                ? (mm == INHIBIT_BLOCK ? "org.freedesktop.login1.inhibit-block-sleep"    : "org.freedesktop.login1.inhibit-delay-sleep") :
-                          w == INHIBIT_IDLE                 ? "org.freedesktop.login1.inhibit-block-idle" :
-                          w == INHIBIT_HANDLE_POWER_KEY     ? "org.freedesktop.login1.inhibit-handle-power-key" :
-                          w == INHIBIT_HANDLE_SUSPEND_KEY   ? "org.freedesktop.login1.inhibit-handle-suspend-key" :
-                          w == INHIBIT_HANDLE_HIBERNATE_KEY ? "org.freedesktop.login1.inhibit-handle-hibernate-key" :
-                                                              "org.freedesktop.login1.inhibit-handle-lid-switch",
-                          false, NULL, error);
+        r = manager_verify_polkit(m, connection, message,
+                                  w == INHIBIT_SHUTDOWN             ? (mm == INHIBIT_BLOCK ? "org.freedesktop.login1.inhibit-block-shutdown" : "org.freedesktop.login1.inhibit-delay-shutdown") :
+                                  w == INHIBIT_SLEEP                ? (mm == INHIBIT_BLOCK ? "org.freedesktop.login1.inhibit-block-sleep"    : "org.freedesktop.login1.inhibit-delay-sleep") :
+                                  w == INHIBIT_IDLE                 ? "org.freedesktop.login1.inhibit-block-idle" :
+                                  w == INHIBIT_HANDLE_POWER_KEY     ? "org.freedesktop.login1.inhibit-handle-power-key" :
+                                  w == INHIBIT_HANDLE_SUSPEND_KEY   ? "org.freedesktop.login1.inhibit-handle-suspend-key" :
+                                  w == INHIBIT_HANDLE_HIBERNATE_KEY ? "org.freedesktop.login1.inhibit-handle-hibernate-key" :
+                                                                      "org.freedesktop.login1.inhibit-handle-lid-switch",
+                                  false, NULL);
         if (r < 0)
                 goto fail;
 
-        ul = dbus_bus_get_unix_user(connection, dbus_message_get_sender(message), error);
-        if (ul == (unsigned long) -1) {
-                r = -EIO;
+        r = manager_get_creds(m, connection, message, &creds);
+        if (r < 0)
                 goto fail;
-        }
-
-        pid = bus_get_unix_process_id(connection, dbus_message_get_sender(message), error);
-        if (pid <= 0) {
-                r = -EIO;
-                goto fail;
-        }
 
         do {
                 free(id);
@@ -822,8 +907,8 @@ static int bus_manager_inhibit(
 
         i->what = w;
         i->mode = mm;
-        i->pid = pid;
-        i->uid = (uid_t) ul;
+        i->pid = creds->pid;
+        i->uid = creds->uid;
         i->why = strdup(why);
         i->who = strdup(who);
 
@@ -1056,55 +1141,103 @@ static int bus_manager_log_shutdown(
                           q, NULL);
 }
 
+static void execute_shutdown_or_sleep_done(BusCall *call, int r, DBusMessage *reply, DBusError *error, void *userdata) {
+        _cleanup_dbus_message_unref_ DBusMessage *request = NULL, *answer = NULL;
+        Manager *m = userdata;
+        const char *p;
+        char *c;
+
+        assert(m);
+        assert(m->action_call == call);
+
+        m->action_call = NULL;
+        request = m->action_request;
+        m->action_request = NULL;
+
+        if (r >= 0) {
+                if (!dbus_message_get_args(
+                                    reply,
+                                    error,
+                                    DBUS_TYPE_OBJECT_PATH, &p,
+                                    DBUS_TYPE_INVALID))
+                        r = -EINVAL;
+                else {
+                        c = strdup(p);
+                        if (!c)
+                                r = -ENOMEM;
+                        else {
+                                free(m->action_job);
+                                m->action_job = c;
+                        }
+                }
+        }
+
+        if (r < 0) {
+                log_warning("Failed to start %s: %s", m->action_unit, bus_error(error, r));
+
+                m->action_unit = NULL;
+                m->action_what = 0;
+        }
+
+        if (!request)
+                return;
+
+        if (r < 0) {
+                bus_send_error_reply(m->bus, request, error, r);
+                return;
+        }
+
+        answer = dbus_message_new_method_return(request);
+        if (!answer || !dbus_connection_send(m->bus, answer, NULL))
+                log_oom();
+}
+
+/* Starts the unit, without waiting for systemd to queue the job. If
+ * request is passed, it is answered once the job is queued, and
+ * -EINPROGRESS is returned; otherwise failures are only logged. */
 static int execute_shutdown_or_sleep(
                 Manager *m,
                 InhibitWhat w,
                 const char *unit_name,
-                DBusError *error) {
+                DBusMessage *request) {
 
-        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
-        const char *mode = "replace-irreversibly", *p;
+        const char *mode = "replace-irreversibly";
         int r;
-        char *c;
 
         assert(m);
         assert(w >= 0);
         assert(w < _INHIBIT_WHAT_MAX);
         assert(unit_name);
+        assert(!m->action_call);
 
         bus_manager_log_shutdown(m, w, unit_name);
 
-        r = bus_method_call_with_reply(
+        r = bus_call_async(
                         m->bus,
+                        0,
+                        execute_shutdown_or_sleep_done,
+                        m,
+                        &m->action_call,
                         "org.freedesktop.systemd1",
                         "/org/freedesktop/systemd1",
                         "org.freedesktop.systemd1.Manager",
                         "StartUnit",
-                        &reply,
-                        error,
                         DBUS_TYPE_STRING, &unit_name,
                         DBUS_TYPE_STRING, &mode,
                         DBUS_TYPE_INVALID);
         if (r < 0)
                 return r;
 
-        if (!dbus_message_get_args(
-                            reply,
-                            error,
-                            DBUS_TYPE_OBJECT_PATH, &p,
-                            DBUS_TYPE_INVALID))
-                return -EINVAL;
-
-        c = strdup(p);
-        if (!c)
-                return -ENOMEM;
-
+        /* Claim the action right away, so that nobody else starts
+         * one while the call is in flight */
         m->action_unit = unit_name;
-        free(m->action_job);
-        m->action_job = c;
         m->action_what = w;
 
-        return 0;
+        if (!request)
+                return 0;
+
+        m->action_request = dbus_message_ref(request);
+        return -EINPROGRESS;
 }
 
 static int delay_shutdown_or_sleep(
@@ -1117,11 +1250,13 @@ static int delay_shutdown_or_sleep(
         assert(w < _INHIBIT_WHAT_MAX);
         assert(unit_name);
 
-        m->action_timestamp = now(CLOCK_MONOTONIC);
+        m->action_timestamp = timer_queue_now(&m->timers);
         m->action_unit = unit_name;
         m->action_what = w;
 
-        return 0;
+        /* Make sure we go ahead once the delay is over, even if
+         * nothing else wakes us up */
+        return timer_start(&m->timers, &m->action_timer, m->action_timestamp + m->inhibit_delay_max, 0);
 }
 
 static int bus_manager_can_shutdown_or_sleep(
@@ -1140,7 +1275,7 @@ static int bus_manager_can_shutdown_or_sleep(
         const char *result = NULL;
         _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
         int r;
-        unsigned long ul;
+        const BusCreds *creds;
 
         assert(m);
         assert(connection);
@@ -1163,19 +1298,19 @@ static int bus_manager_can_shutdown_or_sleep(
                 }
         }
 
-        ul = dbus_bus_get_unix_user(connection, dbus_message_get_sender(message), error);
-        if (ul == (unsigned long) -1)
-                return -EIO;
+        r = manager_get_creds(m, connection, message, &creds);
+        if (r < 0)
+                return r;
 
-        r = have_multiple_sessions(m, (uid_t) ul);
+        r = have_multiple_sessions(m, creds->uid);
         if (r < 0)
                 return r;
 
         multiple_sessions = r > 0;
-        blocked = manager_is_inhibited(m, w, INHIBIT_BLOCK, NULL, false, true, (uid_t) ul);
+        blocked = manager_is_inhibited(m, w, INHIBIT_BLOCK, NULL, false, true, creds->uid);
 
         if (multiple_sessions) {
-                r = verify_polkit(connection, message, action_multiple_sessions, false, &challenge, error);
+                r = manager_verify_polkit(m, connection, message, action_multiple_sessions, false, &challenge);
                 if (r < 0)
                         return r;
 
@@ -1188,7 +1323,7 @@ static int bus_manager_can_shutdown_or_sleep(
         }
 
         if (blocked) {
-                r = verify_polkit(connection, message, action_ignore_inhibit, false, &challenge, error);
+                r = manager_verify_polkit(m, connection, message, action_ignore_inhibit, false, &challenge);
                 if (r < 0)
                         return r;
 
@@ -1204,7 +1339,7 @@ static int bus_manager_can_shutdown_or_sleep(
                 /* If neither inhibit nor multiple sessions
                  * apply then just check the normal policy */
 
-                r = verify_polkit(connection, message, action, false, &challenge, error);
+                r = manager_verify_polkit(m, connection, message, action, false, &challenge);
                 if (r < 0)
                         return r;
 
@@ -1262,7 +1397,7 @@ int bus_manager_shutdown_or_sleep_now_or_later(
                 Manager *m,
                 const char *unit_name,
                 InhibitWhat w,
-                DBusError *error) {
+                DBusMessage *request) {
 
         bool delayed;
         int r;
@@ -1272,6 +1407,7 @@ int bus_manager_shutdown_or_sleep_now_or_later(
         assert(w >= 0);
         assert(w <= _INHIBIT_WHAT_MAX);
         assert(!m->action_job);
+        assert(!m->action_call);
 
         /* Tell everybody to prepare for shutdown/sleep */
         send_prepare_for(m, w, true);
@@ -1287,7 +1423,7 @@ int bus_manager_shutdown_or_sleep_now_or_later(
         else
                 /* Shutdown is not delayed, execute it
                  * immediately */
-                r = execute_shutdown_or_sleep(m, w, unit_name, error);
+                r = execute_shutdown_or_sleep(m, w, unit_name, request);
 
         return r;
 }
@@ -1309,7 +1445,7 @@ static int bus_manager_do_shutdown_or_sleep(
         bool multiple_sessions, blocked;
         DBusMessage *reply = NULL;
         int r;
-        unsigned long ul;
+        const BusCreds *creds;
 
         assert(m);
         assert(connection);
@@ -1343,36 +1479,36 @@ static int bus_manager_do_shutdown_or_sleep(
                         return -ENOTSUP;
         }
 
-        ul = dbus_bus_get_unix_user(connection, dbus_message_get_sender(message), error);
-        if (ul == (unsigned long) -1)
-                return -EIO;
+        r = manager_get_creds(m, connection, message, &creds);
+        if (r < 0)
+                return r;
 
-        r = have_multiple_sessions(m, (uid_t) ul);
+        r = have_multiple_sessions(m, creds->uid);
         if (r < 0)
                 return r;
 
         multiple_sessions = r > 0;
-        blocked = manager_is_inhibited(m, w, INHIBIT_BLOCK, NULL, false, true, (uid_t) ul);
+        blocked = manager_is_inhibited(m, w, INHIBIT_BLOCK, NULL, false, true, creds->uid);
 
         if (multiple_sessions) {
-                r = verify_polkit(connection, message, action_multiple_sessions, interactive, NULL, error);
+                r = manager_verify_polkit(m, connection, message, action_multiple_sessions, interactive, NULL);
                 if (r < 0)
                         return r;
         }
 
         if (blocked) {
-                r = verify_polkit(connection, message, action_ignore_inhibit, interactive, NULL, error);
+                r = manager_verify_polkit(m, connection, message, action_ignore_inhibit, interactive, NULL);
                 if (r < 0)
                         return r;
         }
 
         if (!multiple_sessions && !blocked) {
-                r = verify_polkit(connection, message, action, interactive, NULL, error);
+                r = manager_verify_polkit(m, connection, message, action, interactive, NULL);
                 if (r < 0)
                         return r;
         }
 
-        r = bus_manager_shutdown_or_sleep_now_or_later(m, unit_name, w, error);
+        r = bus_manager_shutdown_or_sleep_now_or_later(m, unit_name, w, message);
         if (r < 0)
                 return r;
 
@@ -1408,10 +1544,18 @@ static const BusProperty bus_login_manager_properties[] = {
         { "IdleActionUSec",         bus_property_append_usec,           "t",  offsetof(Manager, idle_action_usec) },
         { "PreparingForShutdown",   bus_manager_append_preparing,       "b",  0 },
         { "PreparingForSleep",      bus_manager_append_preparing,       "b",  0 },
+        { "EventLoopWakeups",       bus_property_append_uint64,         "t",  offsetof(Manager, n_wakeups)           },
+        { "EventLoopEvents",        bus_property_append_uint64,         "t",  offsetof(Manager, n_events)            },
+        { "GCQueueLength",          bus_manager_append_gc_queue_length, "u",  0 },
+        { "GCUSec",                 bus_property_append_usec,           "t",  offsetof(Manager, gc_usec)             },
+        { "PolkitCacheHits",        bus_property_append_uint64,         "t",  offsetof(Manager, polkit_cache.n_hits) },
+        { "PolkitCacheMisses",      bus_property_append_uint64,         "t",  offsetof(Manager, polkit_cache.n_misses) },
+        { "CredsCacheHits",         bus_property_append_uint64,         "t",  offsetof(Manager, creds.n_hits)        },
+        { "CredsCacheMisses",       bus_property_append_uint64,         "t",  offsetof(Manager, creds.n_misses)      },
         { NULL, }
 };
 
-static DBusHandlerResult manager_message_handler(
+static DBusHandlerResult manager_handle_message(
                 DBusConnection *connection,
                 DBusMessage *message,
                 void *userdata) {
@@ -1428,7 +1572,9 @@ static DBusHandlerResult manager_message_handler(
 
         dbus_error_init(&error);
 
-        if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "GetSession")) {
+        switch (logind_method_from_message(message, LOGIND_OBJECT_MANAGER)) {
+
+        case MANAGER_METHOD_GET_SESSION: {
                 const char *name;
                 char *p;
                 Session *session;
@@ -1462,7 +1608,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!b)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "GetSessionByPID")) {
+                break;
+        }
+
+        case MANAGER_METHOD_GET_SESSION_BY_PID: {
                 uint32_t pid;
                 char *p;
                 Session *session;
@@ -1496,7 +1645,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!b)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "GetUser")) {
+                break;
+        }
+
+        case MANAGER_METHOD_GET_USER: {
                 uint32_t uid;
                 char *p;
                 User *user;
@@ -1530,7 +1682,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!b)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "GetSeat")) {
+                break;
+        }
+
+        case MANAGER_METHOD_GET_SEAT: {
                 const char *name;
                 char *p;
                 Seat *seat;
@@ -1564,190 +1719,94 @@ static DBusHandlerResult manager_message_handler(
                 if (!b)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ListSessions")) {
-                char *p;
-                Session *session;
-                Iterator i;
-                DBusMessageIter iter, sub;
-                const char *empty = "";
-
-                reply = dbus_message_new_method_return(message);
-                if (!reply)
-                        goto oom;
-
-                dbus_message_iter_init_append(reply, &iter);
-
-                if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(susso)", &sub))
-                        goto oom;
-
-                HASHMAP_FOREACH(session, m->sessions, i) {
-                        DBusMessageIter sub2;
-                        uint32_t uid;
-
-                        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2))
-                                goto oom;
-
-                        uid = session->user->uid;
-
-                        p = session_bus_path(session);
-                        if (!p)
-                                goto oom;
-
-                        if (!dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &session->id) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &session->user->name) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, session->seat ? (const char**) &session->seat->id : &empty) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &p)) {
-                                free(p);
-                                goto oom;
-                        }
-
-                        free(p);
-
-                        if (!dbus_message_iter_close_container(&sub, &sub2))
-                                goto oom;
-                }
-
-                if (!dbus_message_iter_close_container(&iter, &sub))
-                        goto oom;
-
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ListUsers")) {
-                char *p;
-                User *user;
-                Iterator i;
-                DBusMessageIter iter, sub;
-
-                reply = dbus_message_new_method_return(message);
-                if (!reply)
-                        goto oom;
-
-                dbus_message_iter_init_append(reply, &iter);
-
-                if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(uso)", &sub))
-                        goto oom;
+                break;
+        }
 
-                HASHMAP_FOREACH(user, m->users, i) {
-                        DBusMessageIter sub2;
-                        uint32_t uid;
+        case MANAGER_METHOD_LIST_SESSIONS:
 
-                        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2))
-                                goto oom;
+                r = bus_manager_list_sessions(m, message, false, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                        uid = user->uid;
+                break;
 
-                        p = user_bus_path(user);
-                        if (!p)
-                                goto oom;
-
-                        if (!dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &user->name) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &p)) {
-                                free(p);
-                                goto oom;
-                        }
+        case MANAGER_METHOD_LIST_SESSIONS_EX:
 
-                        free(p);
+                r = bus_manager_list_sessions(m, message, true, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                        if (!dbus_message_iter_close_container(&sub, &sub2))
-                                goto oom;
-                }
+                break;
 
-                if (!dbus_message_iter_close_container(&iter, &sub))
-                        goto oom;
+        case MANAGER_METHOD_LIST_USERS:
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ListSeats")) {
-                char *p;
-                Seat *seat;
-                Iterator i;
-                DBusMessageIter iter, sub;
+                r = bus_manager_list_users(m, message, false, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                reply = dbus_message_new_method_return(message);
-                if (!reply)
-                        goto oom;
+                break;
 
-                dbus_message_iter_init_append(reply, &iter);
+        case MANAGER_METHOD_LIST_USERS_EX:
 
-                if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(so)", &sub))
-                        goto oom;
+                r = bus_manager_list_users(m, message, true, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                HASHMAP_FOREACH(seat, m->seats, i) {
-                        DBusMessageIter sub2;
+                break;
 
-                        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2))
-                                goto oom;
+        case MANAGER_METHOD_LIST_SEATS:
 
-                        p = seat_bus_path(seat);
-                        if (!p)
-                                goto oom;
+                r = bus_manager_list_seats(m, message, false, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                        if (!dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &seat->id) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &p)) {
-                                free(p);
-                                goto oom;
-                        }
+                break;
 
-                        free(p);
+        case MANAGER_METHOD_LIST_SEATS_EX:
 
-                        if (!dbus_message_iter_close_container(&sub, &sub2))
-                                goto oom;
-                }
+                r = bus_manager_list_seats(m, message, true, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                if (!dbus_message_iter_close_container(&iter, &sub))
-                        goto oom;
+                break;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ListInhibitors")) {
-                Inhibitor *inhibitor;
-                Iterator i;
-                DBusMessageIter iter, sub;
+        case MANAGER_METHOD_LIST_INHIBITORS:
 
-                reply = dbus_message_new_method_return(message);
-                if (!reply)
-                        goto oom;
+                r = bus_manager_list_inhibitors(m, message, false, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                dbus_message_iter_init_append(reply, &iter);
+                break;
 
-                if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(ssssuu)", &sub))
-                        goto oom;
+        case MANAGER_METHOD_LIST_INHIBITORS_EX:
 
-                HASHMAP_FOREACH(inhibitor, m->inhibitors, i) {
-                        DBusMessageIter sub2;
-                        dbus_uint32_t uid, pid;
-                        const char *what, *who, *why, *mode;
+                r = bus_manager_list_inhibitors(m, message, true, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                        if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2))
-                                goto oom;
+                break;
 
-                        what = strempty(inhibit_what_to_string(inhibitor->what));
-                        who = strempty(inhibitor->who);
-                        why = strempty(inhibitor->why);
-                        mode = strempty(inhibit_mode_to_string(inhibitor->mode));
-                        uid = (dbus_uint32_t) inhibitor->uid;
-                        pid = (dbus_uint32_t) inhibitor->pid;
-
-                        if (!dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &what) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &who) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &why) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &mode) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
-                            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &pid))
-                                goto oom;
+        case MANAGER_METHOD_GET_OBJECT_PROPERTIES:
 
-                        if (!dbus_message_iter_close_container(&sub, &sub2))
-                                goto oom;
-                }
+                r = bus_manager_get_object_properties(m, message, &error, &reply);
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
 
-                if (!dbus_message_iter_close_container(&iter, &sub))
-                        goto oom;
+                break;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "Inhibit")) {
+        case MANAGER_METHOD_INHIBIT: {
 
                 r = bus_manager_inhibit(m, connection, message, &error, &reply);
 
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
+                break;
+        }
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CreateSession")) {
+        case MANAGER_METHOD_CREATE_SESSION: {
 
                 r = bus_manager_create_session(m, message, &reply);
 
@@ -1759,7 +1818,10 @@ static DBusHandlerResult manager_message_handler(
                 if (r < 0)
                         return bus_send_error_reply(connection, message, NULL, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ReleaseSession")) {
+                break;
+        }
+
+        case MANAGER_METHOD_RELEASE_SESSION: {
                 const char *name;
                 Session *session;
 
@@ -1786,7 +1848,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ActivateSession")) {
+                break;
+        }
+
+        case MANAGER_METHOD_ACTIVATE_SESSION: {
                 const char *name;
                 Session *session;
 
@@ -1809,7 +1874,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "ActivateSessionOnSeat")) {
+                break;
+        }
+
+        case MANAGER_METHOD_ACTIVATE_SESSION_ON_SEAT: {
                 const char *session_name, *seat_name;
                 Session *session;
                 Seat *seat;
@@ -1844,8 +1912,11 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "LockSession") ||
-                   dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "UnlockSession")) {
+                break;
+        }
+
+        case MANAGER_METHOD_LOCK_SESSION:
+        case MANAGER_METHOD_UNLOCK_SESSION: {
                 const char *name;
                 Session *session;
 
@@ -1867,8 +1938,11 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "LockSessions") ||
-                   dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "UnlockSessions")) {
+                break;
+        }
+
+        case MANAGER_METHOD_LOCK_SESSIONS:
+        case MANAGER_METHOD_UNLOCK_SESSIONS: {
 
                 r = session_send_lock_all(m, streq(dbus_message_get_member(message), "LockSessions"));
                 if (r < 0)
@@ -1878,7 +1952,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "KillSession")) {
+                break;
+        }
+
+        case MANAGER_METHOD_KILL_SESSION: {
                 const char *swho;
                 int32_t signo;
                 KillWho who;
@@ -1917,7 +1994,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "KillUser")) {
+                break;
+        }
+
+        case MANAGER_METHOD_KILL_USER: {
                 uint32_t uid;
                 User *user;
                 int32_t signo;
@@ -1945,7 +2025,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "TerminateSession")) {
+                break;
+        }
+
+        case MANAGER_METHOD_TERMINATE_SESSION: {
                 const char *name;
                 Session *session;
 
@@ -1968,7 +2051,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "TerminateUser")) {
+                break;
+        }
+
+        case MANAGER_METHOD_TERMINATE_USER: {
                 uint32_t uid;
                 User *user;
 
@@ -1991,7 +2077,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "TerminateSeat")) {
+                break;
+        }
+
+        case MANAGER_METHOD_TERMINATE_SEAT: {
                 const char *name;
                 Seat *seat;
 
@@ -2014,7 +2103,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "SetUserLinger")) {
+                break;
+        }
+
+        case MANAGER_METHOD_SET_USER_LINGER: {
                 uint32_t uid;
                 struct passwd *pw;
                 dbus_bool_t b, interactive;
@@ -2034,7 +2126,9 @@ static DBusHandlerResult manager_message_handler(
                 if (!pw)
                         return bus_send_error_reply(connection, message, NULL, errno ? -errno : -EINVAL);
 
-                r = verify_polkit(connection, message, "org.freedesktop.login1.set-user-linger", interactive, NULL, &error);
+                r = manager_verify_polkit(m, connection, message, "org.freedesktop.login1.set-user-linger", interactive, NULL);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
@@ -2078,7 +2172,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "AttachDevice")) {
+                break;
+        }
+
+        case MANAGER_METHOD_ATTACH_DEVICE: {
                 const char *sysfs, *seat;
                 dbus_bool_t interactive;
 
@@ -2094,7 +2191,9 @@ static DBusHandlerResult manager_message_handler(
                 if (!path_startswith(sysfs, "/sys") || !seat_name_is_valid(seat))
                         return bus_send_error_reply(connection, message, NULL, -EINVAL);
 
-                r = verify_polkit(connection, message, "org.freedesktop.login1.attach-device", interactive, NULL, &error);
+                r = manager_verify_polkit(m, connection, message, "org.freedesktop.login1.attach-device", interactive, NULL);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
@@ -2106,8 +2205,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
+                break;
+        }
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "FlushDevices")) {
+        case MANAGER_METHOD_FLUSH_DEVICES: {
                 dbus_bool_t interactive;
 
                 if (!dbus_message_get_args(
@@ -2117,7 +2218,9 @@ static DBusHandlerResult manager_message_handler(
                                     DBUS_TYPE_INVALID))
                         return bus_send_error_reply(connection, message, &error, -EINVAL);
 
-                r = verify_polkit(connection, message, "org.freedesktop.login1.flush-devices", interactive, NULL, &error);
+                r = manager_verify_polkit(m, connection, message, "org.freedesktop.login1.flush-devices", interactive, NULL);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
@@ -2129,7 +2232,10 @@ static DBusHandlerResult manager_message_handler(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "PowerOff")) {
+                break;
+        }
+
+        case MANAGER_METHOD_POWER_OFF: {
 
                 r = bus_manager_do_shutdown_or_sleep(
                                 m, connection, message,
@@ -2140,9 +2246,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.power-off-ignore-inhibit",
                                 NULL,
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "Reboot")) {
+
+                break;
+        }
+
+        case MANAGER_METHOD_REBOOT: {
                 r = bus_manager_do_shutdown_or_sleep(
                                 m, connection, message,
                                 SPECIAL_REBOOT_TARGET,
@@ -2152,10 +2264,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.reboot-ignore-inhibit",
                                 NULL,
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "Suspend")) {
+                break;
+        }
+
+        case MANAGER_METHOD_SUSPEND: {
                 r = bus_manager_do_shutdown_or_sleep(
                                 m, connection, message,
                                 SPECIAL_SUSPEND_TARGET,
@@ -2165,9 +2282,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.suspend-ignore-inhibit",
                                 "suspend",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "Hibernate")) {
+
+                break;
+        }
+
+        case MANAGER_METHOD_HIBERNATE: {
                 r = bus_manager_do_shutdown_or_sleep(
                                 m, connection, message,
                                 SPECIAL_HIBERNATE_TARGET,
@@ -2177,10 +2300,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.hibernate-ignore-inhibit",
                                 "hibernate",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "HybridSleep")) {
+                break;
+        }
+
+        case MANAGER_METHOD_HYBRID_SLEEP: {
                 r = bus_manager_do_shutdown_or_sleep(
                                 m, connection, message,
                                 SPECIAL_HYBRID_SLEEP_TARGET,
@@ -2190,10 +2318,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.hibernate-ignore-inhibit",
                                 "hybrid-sleep",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CanPowerOff")) {
+                break;
+        }
+
+        case MANAGER_METHOD_CAN_POWER_OFF: {
 
                 r = bus_manager_can_shutdown_or_sleep(
                                 m, connection, message,
@@ -2203,9 +2336,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.power-off-ignore-inhibit",
                                 NULL,
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CanReboot")) {
+
+                break;
+        }
+
+        case MANAGER_METHOD_CAN_REBOOT: {
                 r = bus_manager_can_shutdown_or_sleep(
                                 m, connection, message,
                                 INHIBIT_SHUTDOWN,
@@ -2214,10 +2353,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.reboot-ignore-inhibit",
                                 NULL,
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CanSuspend")) {
+                break;
+        }
+
+        case MANAGER_METHOD_CAN_SUSPEND: {
                 r = bus_manager_can_shutdown_or_sleep(
                                 m, connection, message,
                                 INHIBIT_SLEEP,
@@ -2226,10 +2370,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.suspend-ignore-inhibit",
                                 "suspend",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CanHibernate")) {
+                break;
+        }
+
+        case MANAGER_METHOD_CAN_HIBERNATE: {
                 r = bus_manager_can_shutdown_or_sleep(
                                 m, connection, message,
                                 INHIBIT_SLEEP,
@@ -2238,10 +2387,15 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.hibernate-ignore-inhibit",
                                 "hibernate",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Manager", "CanHybridSleep")) {
+                break;
+        }
+
+        case MANAGER_METHOD_CAN_HYBRID_SLEEP: {
                 r = bus_manager_can_shutdown_or_sleep(
                                 m, connection, message,
                                 INHIBIT_SLEEP,
@@ -2250,10 +2404,56 @@ static DBusHandlerResult manager_message_handler(
                                 "org.freedesktop.login1.hibernate-ignore-inhibit",
                                 "hybrid-sleep",
                                 &error, &reply);
+                if (r == -EINPROGRESS)
+                        break;
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, &error, r);
+
+                break;
+        }
+
+        case MANAGER_METHOD_GET_STATS: {
+                DBusMessageIter iter;
+
+                reply = dbus_message_new_method_return(message);
+                if (!reply)
+                        goto oom;
+
+                dbus_message_iter_init_append(reply, &iter);
+
+                r = stats_append(&m->stats, &iter);
+                if (r < 0)
+                        goto oom;
+
+                break;
+        }
+
+        case MANAGER_METHOD_RESET_STATS: {
+                dbus_bool_t interactive;
+
+                if (!dbus_message_get_args(
+                                    message,
+                                    &error,
+                                    DBUS_TYPE_BOOLEAN, &interactive,
+                                    DBUS_TYPE_INVALID))
+                        return bus_send_error_reply(connection, message, &error, -EINVAL);
+
+                r = manager_verify_polkit(m, connection, message, "org.freedesktop.login1.reset-stats", interactive, NULL);
+                if (r == -EINPROGRESS)
+                        break;
                 if (r < 0)
                         return bus_send_error_reply(connection, message, &error, r);
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.DBus.Introspectable", "Introspect")) {
+                stats_reset(&m->stats);
+
+                reply = dbus_message_new_method_return(message);
+                if (!reply)
+                        goto oom;
+
+                break;
+        }
+
+        case MANAGER_METHOD_INTROSPECT: {
                 char *introspection = NULL;
                 FILE *f;
                 Iterator i;
@@ -2316,13 +2516,18 @@ static DBusHandlerResult manager_message_handler(
                 }
 
                 free(introspection);
-        } else {
+
+                break;
+        }
+
+        default: {
                 const BusBoundProperties bps[] = {
                         { "org.freedesktop.login1.Manager", bus_login_manager_properties, m },
                         { NULL, }
                 };
                 return bus_default_message_handler(connection, message, NULL, INTERFACES_LIST, bps);
         }
+        }
 
         if (reply) {
                 if (!bus_maybe_send_reply(connection, message, reply))
@@ -2337,6 +2542,38 @@ oom:
         return DBUS_HANDLER_RESULT_NEED_MEMORY;
 }
 
+static DBusHandlerResult manager_message_handler(
+                DBusConnection *connection,
+                DBusMessage *message,
+                void *userdata) {
+
+        Manager *m = userdata;
+        const struct LogindMethod *method;
+        DBusHandlerResult result;
+        usec_t start, end;
+
+        assert(m);
+
+        if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+                return manager_handle_message(connection, message, userdata);
+
+        method = logind_method_find(message);
+        if (method && method->object != LOGIND_OBJECT_MANAGER)
+                method = NULL;
+
+        start = now(CLOCK_MONOTONIC);
+        stall_monitor_enter(&m->stall_monitor, dbus_message_get_member(message), start);
+
+        result = manager_handle_message(connection, message, userdata);
+
+        end = now(CLOCK_MONOTONIC);
+        stall_monitor_leave(&m->stall_monitor, end);
+
+        stats_record_method(&m->stats, method ? method->name : NULL, end - start);
+
+        return result;
+}
+
 const DBusObjectPathVTable bus_manager_vtable = {
         .message_function = manager_message_handler
 };
@@ -2355,7 +2592,32 @@ DBusHandlerResult bus_message_filter(
 
         dbus_error_init(&error);
 
-        if (dbus_message_is_signal(message, "org.freedesktop.systemd1.Agent", "Released")) {
+        if (dbus_message_is_signal(message, "org.freedesktop.PolicyKit1.Authority", "Changed")) {
+
+                /* Actions or rules changed, nothing we remember is
+                 * reliable anymore */
+                polkit_cache_flush(&m->polkit_cache);
+
+        } else if (dbus_message_is_signal(message, DBUS_INTERFACE_DBUS, "NameOwnerChanged")) {
+                const char *name, *old_owner, *new_owner;
+
+                if (!dbus_message_get_args(message, &error,
+                                           DBUS_TYPE_STRING, &name,
+                                           DBUS_TYPE_STRING, &old_owner,
+                                           DBUS_TYPE_STRING, &new_owner,
+                                           DBUS_TYPE_INVALID))
+                        log_error("Failed to parse NameOwnerChanged message: %s", bus_error_message(&error));
+
+                /* We only get these for names that lost their owner */
+                else if (streq(name, "org.freedesktop.PolicyKit1"))
+                        polkit_cache_flush(&m->polkit_cache);
+
+                else if (name[0] == ':' && isempty(new_owner)) {
+                        bus_creds_cache_forget(&m->creds, name);
+                        polkit_cache_forget_sender(&m->polkit_cache, name);
+                }
+
+        } else if (dbus_message_is_signal(message, "org.freedesktop.systemd1.Agent", "Released")) {
                 const char *cgroup;
 
                 if (!dbus_message_get_args(message, &error,
@@ -2413,29 +2675,28 @@ int manager_send_changed(Manager *manager, const char *properties) {
 }
 
 int manager_dispatch_delayed(Manager *manager) {
-        DBusError error;
         int r;
 
         assert(manager);
 
-        if (manager->action_what == 0 || manager->action_job)
+        if (manager->action_what == 0 || manager->action_job || manager->action_call)
                 return 0;
 
         /* Continue delay? */
         if (manager_is_inhibited(manager, manager->action_what, INHIBIT_DELAY, NULL, false, false, 0)) {
 
-                if (manager->action_timestamp + manager->inhibit_delay_max > now(CLOCK_MONOTONIC))
+                if (manager->action_timestamp + manager->inhibit_delay_max > timer_queue_now(&manager->timers))
                         return 0;
 
                 log_info("Delay lock is active but inhibitor timeout is reached.");
         }
 
+        timer_stop(&manager->timers, &manager->action_timer);
+
         /* Actually do the operation */
-        dbus_error_init(&error);
-        r = execute_shutdown_or_sleep(manager, manager->action_what, manager->action_unit, &error);
+        r = execute_shutdown_or_sleep(manager, manager->action_what, manager->action_unit, NULL);
         if (r < 0) {
-                log_warning("Failed to send delayed message: %s", bus_error(&error, r));
-                dbus_error_free(&error);
+                log_warning("Failed to send delayed message: %s", strerror(-r));
 
                 manager->action_unit = NULL;
                 manager->action_what = 0;
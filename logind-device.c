@@ -24,6 +24,9 @@
 
 #include "logind-device.h"
 #include "util.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(device_pool, Device, 64);
 
 Device* device_new(Manager *m, const char *sysfs) {
         Device *d;
@@ -31,19 +34,19 @@ Device* device_new(Manager *m, const char *sysfs) {
         assert(m);
         assert(sysfs);
 
-        d = new0(Device, 1);
+        d = mempool_alloc0_tile(&device_pool);
         if (!d)
                 return NULL;
 
         d->sysfs = strdup(sysfs);
         if (!d->sysfs) {
-                free(d);
+                mempool_free_tile(&device_pool, d);
                 return NULL;
         }
 
         if (hashmap_put(m->devices, d->sysfs, d) < 0) {
                 free(d->sysfs);
-                free(d);
+                mempool_free_tile(&device_pool, d);
                 return NULL;
         }
 
@@ -61,7 +64,7 @@ void device_free(Device *d) {
         hashmap_remove(d->manager->devices, d->sysfs);
 
         free(d->sysfs);
-        free(d);
+        mempool_free_tile(&device_pool, d);
 }
 
 void device_detach(Device *d) {
@@ -0,0 +1,187 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <string.h>
+
+#include "logind.h"
+
+int manager_add_fd_object(Manager *m, int fd, FdObjectType type, void *object) {
+        assert(m);
+        assert(fd >= 0);
+        assert(type != FD_OBJECT_NONE);
+        assert(object);
+
+        if ((unsigned) fd >= m->n_fd_objects) {
+                FdObject *t;
+                unsigned n;
+
+                n = MAX((unsigned) fd + 1, MAX(m->n_fd_objects * 2, 64U));
+
+                t = realloc(m->fd_objects, n * sizeof(FdObject));
+                if (!t)
+                        return -ENOMEM;
+
+                memset(t + m->n_fd_objects, 0, (n - m->n_fd_objects) * sizeof(FdObject));
+
+                m->fd_objects = t;
+                m->n_fd_objects = n;
+        }
+
+        if (m->fd_objects[fd].type != FD_OBJECT_NONE)
+                return -EEXIST;
+
+        m->fd_objects[fd].type = type;
+        m->fd_objects[fd].object = object;
+        m->fd_objects[fd].wakeup = m->n_wakeups;
+
+        return 0;
+}
+
+void *manager_remove_fd_object(Manager *m, int fd) {
+        void *object;
+
+        assert(m);
+        assert(fd >= 0);
+
+        if ((unsigned) fd >= m->n_fd_objects)
+                return NULL;
+
+        object = m->fd_objects[fd].object;
+
+        m->fd_objects[fd].type = FD_OBJECT_NONE;
+        m->fd_objects[fd].object = NULL;
+
+        return object;
+}
+
+FdObject *manager_get_fd_object(Manager *m, int fd) {
+        FdObject *o;
+
+        assert(m);
+        assert(fd >= 0);
+
+        if ((unsigned) fd >= m->n_fd_objects)
+                return NULL;
+
+        o = m->fd_objects + fd;
+
+        /* An earlier event of the same batch may have closed the fd,
+         * and possibly reused the number for a new object, which the
+         * event hence isn't about */
+        if (o->type == FD_OBJECT_NONE || o->wakeup == m->n_wakeups)
+                return NULL;
+
+        return o;
+}
+
+static const StatsSource fd_object_stats_source[] = {
+        [FD_OBJECT_NONE] = STATS_FD_OTHER,
+        [FD_OBJECT_SESSION] = STATS_FD_SESSION,
+        [FD_OBJECT_INHIBITOR] = STATS_FD_INHIBITOR,
+        [FD_OBJECT_BUTTON] = STATS_FD_BUTTON,
+        [FD_OBJECT_BUS] = STATS_FD_BUS,
+};
+
+StatsSource manager_event_stats_source(Manager *m, uint32_t u) {
+        unsigned fd;
+
+        assert(m);
+
+        switch (u) {
+
+        case FD_SEAT_UDEV:
+                return STATS_FD_SEAT_UDEV;
+
+        case FD_VCSA_UDEV:
+                return STATS_FD_VCSA_UDEV;
+
+        case FD_BUTTON_UDEV:
+                return STATS_FD_BUTTON_UDEV;
+
+        case FD_CONSOLE:
+                return STATS_FD_CONSOLE;
+
+        case FD_TIMER:
+                return STATS_FD_TIMER;
+        }
+
+        if (u < FD_OTHER_BASE)
+                return STATS_FD_OTHER;
+
+        fd = u - FD_OTHER_BASE;
+        if (fd >= m->n_fd_objects)
+                return STATS_FD_OTHER;
+
+        return fd_object_stats_source[m->fd_objects[fd].type];
+}
+
+static const EventClass stats_source_event_class[_STATS_SOURCE_MAX] = {
+        [STATS_FD_SEAT_UDEV] = EVENT_CLASS_UDEV,
+        [STATS_FD_VCSA_UDEV] = EVENT_CLASS_UDEV,
+        [STATS_FD_BUTTON_UDEV] = EVENT_CLASS_UDEV,
+        [STATS_FD_CONSOLE] = EVENT_CLASS_TIMER,
+        [STATS_FD_TIMER] = EVENT_CLASS_TIMER,
+        [STATS_FD_SESSION] = EVENT_CLASS_FIFO,
+        [STATS_FD_INHIBITOR] = EVENT_CLASS_FIFO,
+        [STATS_FD_BUTTON] = EVENT_CLASS_TIMER,
+        [STATS_FD_BUS] = EVENT_CLASS_BUS,
+        [STATS_FD_OTHER] = EVENT_CLASS_FIFO,
+};
+
+EventClass event_class_from_stats_source(StatsSource s) {
+        assert(s >= 0 && s < _STATS_SOURCE_MAX);
+
+        return stats_source_event_class[s];
+}
+
+unsigned event_batch_order(
+                const EventClass *classes,
+                unsigned n,
+                const unsigned budget[_EVENT_CLASS_MAX],
+                unsigned *order,
+                unsigned class_end[_EVENT_CLASS_MAX]) {
+
+        unsigned c, k, n_order = 0;
+
+        assert(classes || n == 0);
+        assert(budget);
+        assert(order || n == 0);
+        assert(class_end);
+
+        for (c = 0; c < _EVENT_CLASS_MAX; c++) {
+                unsigned taken = 0;
+
+                for (k = 0; k < n; k++) {
+                        if (classes[k] != c)
+                                continue;
+
+                        if (budget[c] > 0 && taken >= budget[c])
+                                break;
+
+                        order[n_order++] = k;
+                        taken++;
+                }
+
+                class_end[c] = taken > 0 ? n_order : 0;
+        }
+
+        return n_order;
+}
@@ -31,19 +31,22 @@
 #include "path-util.h"
 #include "logind-inhibit.h"
 #include "fileio.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(inhibitor_pool, Inhibitor, 64);
 
 Inhibitor* inhibitor_new(Manager *m, const char* id) {
         Inhibitor *i;
 
         assert(m);
 
-        i = new0(Inhibitor, 1);
+        i = mempool_alloc0_tile(&inhibitor_pool);
         if (!i)
                 return NULL;
 
         i->state_file = strappend("/run/systemd/inhibit/", id);
         if (!i->state_file) {
-                free(i);
+                mempool_free_tile(&inhibitor_pool, i);
                 return NULL;
         }
 
@@ -51,7 +54,7 @@ Inhibitor* inhibitor_new(Manager *m, const char* id) {
 
         if (hashmap_put(m->inhibitors, i->id, i) < 0) {
                 free(i->state_file);
-                free(i);
+                mempool_free_tile(&inhibitor_pool, i);
                 return NULL;
         }
 
@@ -75,16 +78,19 @@ void inhibitor_free(Inhibitor *i) {
                 free(i->state_file);
         }
 
-        free(i);
+        mempool_free_tile(&inhibitor_pool, i);
 }
 
 int inhibitor_save(Inhibitor *i) {
         char *temp_path, *cc;
         int r;
         FILE *f;
+        usec_t start;
 
         assert(i);
 
+        start = now(CLOCK_MONOTONIC);
+
         r = mkdir_safe_label("/run/systemd/inhibit", 0755, 0, 0);
         if (r < 0)
                 goto finish;
@@ -141,12 +147,99 @@ int inhibitor_save(Inhibitor *i) {
         free(temp_path);
 
 finish:
+        stats_record_since(&i->manager->stats, STATS_SAVE, start);
+
         if (r < 0)
                 log_error("Failed to save inhibit data for %s: %s", i->id, strerror(-r));
 
         return r;
 }
 
+static void inhibitor_index_link(Inhibitor *i) {
+        unsigned b;
+
+        assert_cc((1 << INHIBIT_WHAT_BITS) == _INHIBIT_WHAT_MAX);
+
+        assert(i);
+        assert(!i->in_index);
+        assert(i->mode >= 0 && i->mode < _INHIBIT_MODE_MAX);
+
+        for (b = 0; b < INHIBIT_WHAT_BITS; b++) {
+                InhibitorList *l;
+                Inhibitor *a;
+
+                if (!(i->what & (1 << b)))
+                        continue;
+
+                l = &i->manager->inhibitor_index[i->mode][b];
+
+                /* Usually we are the youngest, hence this search
+                 * ends right away at the tail */
+                for (a = l->tail; a && a->since.monotonic > i->since.monotonic; a = a->by_what[b].prev)
+                        ;
+
+                i->by_what[b].prev = a;
+                i->by_what[b].next = a ? a->by_what[b].next : l->head;
+
+                if (i->by_what[b].next)
+                        i->by_what[b].next->by_what[b].prev = i;
+                else
+                        l->tail = i;
+
+                if (a)
+                        a->by_what[b].next = i;
+                else
+                        l->head = i;
+        }
+
+        i->in_index = true;
+}
+
+static void inhibitor_index_unlink(Inhibitor *i) {
+        unsigned b;
+
+        assert(i);
+        assert(i->in_index);
+
+        for (b = 0; b < INHIBIT_WHAT_BITS; b++) {
+                InhibitorList *l;
+
+                if (!(i->what & (1 << b)))
+                        continue;
+
+                l = &i->manager->inhibitor_index[i->mode][b];
+
+                if (i->by_what[b].next)
+                        i->by_what[b].next->by_what[b].prev = i->by_what[b].prev;
+                else
+                        l->tail = i->by_what[b].prev;
+
+                if (i->by_what[b].prev)
+                        i->by_what[b].prev->by_what[b].next = i->by_what[b].next;
+                else
+                        l->head = i->by_what[b].next;
+
+                i->by_what[b].next = i->by_what[b].prev = NULL;
+        }
+
+        i->in_index = false;
+}
+
+static void inhibitor_update_index(Inhibitor *i) {
+        bool b;
+
+        assert(i);
+
+        /* Only inhibitors whose FIFO is still open are taken into
+         * account */
+        b = i->fifo_fd >= 0;
+
+        if (b && !i->in_index)
+                inhibitor_index_link(i);
+        else if (!b && i->in_index)
+                inhibitor_index_unlink(i);
+}
+
 int inhibitor_start(Inhibitor *i) {
         assert(i);
 
@@ -155,6 +248,13 @@ int inhibitor_start(Inhibitor *i) {
 
         dual_timestamp_get(&i->since);
 
+        /* The FIFO is usually open already, move us to where our new
+         * age puts us in the index */
+        if (i->in_index) {
+                inhibitor_index_unlink(i);
+                inhibitor_index_link(i);
+        }
+
         log_debug("Inhibitor %s (%s) pid=%lu uid=%lu mode=%s started.",
                   strna(i->who), strna(i->why),
                   (unsigned long) i->pid, (unsigned long) i->uid,
@@ -298,7 +398,7 @@ int inhibitor_create_fifo(Inhibitor *i) {
                 if (i->fifo_fd < 0)
                         return -errno;
 
-                r = hashmap_put(i->manager->inhibitor_fds, INT_TO_PTR(i->fifo_fd + 1), i);
+                r = manager_add_fd_object(i->manager, i->fifo_fd, FD_OBJECT_INHIBITOR, i);
                 if (r < 0)
                         return r;
 
@@ -307,6 +407,8 @@ int inhibitor_create_fifo(Inhibitor *i) {
 
                 if (epoll_ctl(i->manager->epoll_fd, EPOLL_CTL_ADD, i->fifo_fd, &ev) < 0)
                         return -errno;
+
+                inhibitor_update_index(i);
         }
 
         /* Open writing side */
@@ -321,10 +423,12 @@ void inhibitor_remove_fifo(Inhibitor *i) {
         assert(i);
 
         if (i->fifo_fd >= 0) {
-                assert_se(hashmap_remove(i->manager->inhibitor_fds, INT_TO_PTR(i->fifo_fd + 1)) == i);
+                assert_se(manager_remove_fd_object(i->manager, i->fifo_fd) == i);
                 assert_se(epoll_ctl(i->manager->epoll_fd, EPOLL_CTL_DEL, i->fifo_fd, NULL) == 0);
                 close_nointr_nofail(i->fifo_fd);
                 i->fifo_fd = -1;
+
+                inhibitor_update_index(i);
         }
 
         if (i->fifo_path) {
@@ -335,15 +439,15 @@ void inhibitor_remove_fifo(Inhibitor *i) {
 }
 
 InhibitWhat manager_inhibit_what(Manager *m, InhibitMode mm) {
-        Inhibitor *i;
-        Iterator j;
         InhibitWhat what = 0;
+        unsigned b;
 
         assert(m);
+        assert(mm >= 0 && mm < _INHIBIT_MODE_MAX);
 
-        HASHMAP_FOREACH(i, m->inhibitor_fds, j)
-                if (i->mode == mm)
-                        what |= i->what;
+        for (b = 0; b < INHIBIT_WHAT_BITS; b++)
+                if (m->inhibitor_index[mm][b].head)
+                        what |= 1 << b;
 
         return what;
 }
@@ -374,31 +478,36 @@ bool manager_is_inhibited(
                 uid_t uid) {
 
         Inhibitor *i;
-        Iterator j;
         struct dual_timestamp ts = { 0, 0 };
         bool inhibited = false;
+        unsigned b;
 
         assert(m);
         assert(w > 0 && w < _INHIBIT_WHAT_MAX);
+        assert(mm >= 0 && mm < _INHIBIT_MODE_MAX);
 
-        HASHMAP_FOREACH(i, m->inhibitor_fds, j) {
-                if (!(i->what & w))
+        for (b = 0; b < INHIBIT_WHAT_BITS; b++) {
+                if (!(w & (1 << b)))
                         continue;
 
-                if (i->mode != mm)
-                        continue;
+                /* The lists are ordered by age, hence the first
+                 * inhibitor that qualifies is the oldest one. Without
+                 * filters that's always the head. */
+                for (i = m->inhibitor_index[mm][b].head; i; i = i->by_what[b].next) {
 
-                if (ignore_inactive && pid_is_active(m, i->pid) <= 0)
-                        continue;
+                        if (ignore_inactive && pid_is_active(m, i->pid) <= 0)
+                                continue;
 
-                if (ignore_uid && i->uid == uid)
-                        continue;
+                        if (ignore_uid && i->uid == uid)
+                                continue;
 
-                if (!inhibited ||
-                    i->since.monotonic < ts.monotonic)
-                        ts = i->since;
+                        if (!inhibited ||
+                            i->since.monotonic < ts.monotonic)
+                                ts = i->since;
 
-                inhibited = true;
+                        inhibited = true;
+                        break;
+                }
         }
 
         if (since)
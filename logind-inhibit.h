@@ -39,6 +39,8 @@ typedef enum InhibitWhat {
         _INHIBIT_WHAT_INVALID = -1
 } InhibitWhat;
 
+#define INHIBIT_WHAT_BITS 7
+
 typedef enum InhibitMode {
         INHIBIT_BLOCK,
         INHIBIT_DELAY,
@@ -46,6 +48,16 @@ typedef enum InhibitMode {
         _INHIBIT_MODE_INVALID = -1
 } InhibitMode;
 
+/* Active inhibitors taking one what bit in one mode, in order of
+ * their since timestamp, so the oldest is always at the head */
+typedef struct InhibitorList {
+        Inhibitor *head, *tail;
+} InhibitorList;
+
+typedef struct InhibitorLink {
+        Inhibitor *next, *prev;
+} InhibitorLink;
+
 #include "logind.h"
 #include "logind-seat.h"
 
@@ -69,6 +81,9 @@ struct Inhibitor {
 
         char *fifo_path;
         int fifo_fd;
+
+        bool in_index;
+        InhibitorLink by_what[INHIBIT_WHAT_BITS];
 };
 
 Inhibitor* inhibitor_new(Manager *m, const char *id);
@@ -0,0 +1,848 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "logind-list.h"
+#include "dbus-common.h"
+
+typedef enum ListFilterKey {
+        LIST_FILTER_UID = 1 << 0,
+        LIST_FILTER_SEAT = 1 << 1,
+        LIST_FILTER_CLASS = 1 << 2,
+        LIST_FILTER_TYPE = 1 << 3,
+        LIST_FILTER_STATE = 1 << 4,
+        LIST_FILTER_REMOTE = 1 << 5,
+        LIST_FILTER_WHAT = 1 << 6,
+        LIST_FILTER_MODE = 1 << 7
+} ListFilterKey;
+
+#define SESSION_FILTERS (LIST_FILTER_UID|LIST_FILTER_SEAT|LIST_FILTER_CLASS|LIST_FILTER_TYPE|LIST_FILTER_STATE|LIST_FILTER_REMOTE)
+#define USER_FILTERS (LIST_FILTER_STATE)
+#define INHIBITOR_FILTERS (LIST_FILTER_UID|LIST_FILTER_WHAT|LIST_FILTER_MODE)
+
+typedef struct ListArgs {
+        unsigned set;
+
+        uid_t uid;
+        const char *seat;
+        SessionClass class;
+        SessionType type;
+        const char *state;
+        bool remote;
+        InhibitWhat what;
+        InhibitMode mode;
+
+        const char *cursor;
+        uint32_t limit;
+} ListArgs;
+
+static const struct {
+        const char *name;
+        int type;
+        ListFilterKey key;
+} list_filter_table[] = {
+        { "uid",    DBUS_TYPE_UINT32,  LIST_FILTER_UID    },
+        { "seat",   DBUS_TYPE_STRING,  LIST_FILTER_SEAT   },
+        { "class",  DBUS_TYPE_STRING,  LIST_FILTER_CLASS  },
+        { "type",   DBUS_TYPE_STRING,  LIST_FILTER_TYPE   },
+        { "state",  DBUS_TYPE_STRING,  LIST_FILTER_STATE  },
+        { "remote", DBUS_TYPE_BOOLEAN, LIST_FILTER_REMOTE },
+        { "what",   DBUS_TYPE_STRING,  LIST_FILTER_WHAT   },
+        { "mode",   DBUS_TYPE_STRING,  LIST_FILTER_MODE   },
+};
+
+static int list_filter_read(DBusMessageIter *i, unsigned allowed, DBusError *error, ListArgs *a) {
+        DBusMessageIter entry, variant;
+        const char *name, *s;
+        dbus_uint32_t u;
+        dbus_bool_t b;
+        unsigned k;
+
+        dbus_message_iter_recurse(i, &entry);
+
+        if (dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_STRING)
+                return -EINVAL;
+
+        dbus_message_iter_get_basic(&entry, &name);
+
+        if (!dbus_message_iter_next(&entry) ||
+            dbus_message_iter_get_arg_type(&entry) != DBUS_TYPE_VARIANT)
+                return -EINVAL;
+
+        dbus_message_iter_recurse(&entry, &variant);
+
+        for (k = 0; k < ELEMENTSOF(list_filter_table); k++)
+                if (streq(list_filter_table[k].name, name))
+                        break;
+
+        if (k >= ELEMENTSOF(list_filter_table) || !(allowed & list_filter_table[k].key)) {
+                dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Unknown filter %s", name);
+                return -EINVAL;
+        }
+
+        if (dbus_message_iter_get_arg_type(&variant) != list_filter_table[k].type) {
+                dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Filter %s has the wrong type", name);
+                return -EINVAL;
+        }
+
+        switch (list_filter_table[k].key) {
+
+        case LIST_FILTER_UID:
+                dbus_message_iter_get_basic(&variant, &u);
+                a->uid = (uid_t) u;
+                break;
+
+        case LIST_FILTER_SEAT:
+                dbus_message_iter_get_basic(&variant, &a->seat);
+                break;
+
+        case LIST_FILTER_CLASS:
+                dbus_message_iter_get_basic(&variant, &s);
+                a->class = session_class_from_string(s);
+                if (a->class < 0)
+                        goto invalid;
+                break;
+
+        case LIST_FILTER_TYPE:
+                dbus_message_iter_get_basic(&variant, &s);
+                a->type = session_type_from_string(s);
+                if (a->type < 0)
+                        goto invalid;
+                break;
+
+        case LIST_FILTER_STATE:
+                /* Checked by the caller, sessions and users have
+                 * different states */
+                dbus_message_iter_get_basic(&variant, &a->state);
+                break;
+
+        case LIST_FILTER_REMOTE:
+                dbus_message_iter_get_basic(&variant, &b);
+                a->remote = b;
+                break;
+
+        case LIST_FILTER_WHAT:
+                dbus_message_iter_get_basic(&variant, &s);
+                a->what = inhibit_what_from_string(s);
+                if (a->what <= 0)
+                        goto invalid;
+                break;
+
+        case LIST_FILTER_MODE:
+                dbus_message_iter_get_basic(&variant, &s);
+                a->mode = inhibit_mode_from_string(s);
+                if (a->mode < 0)
+                        goto invalid;
+                break;
+        }
+
+        a->set |= list_filter_table[k].key;
+        return 0;
+
+invalid:
+        dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Invalid %s filter %s", name, s);
+        return -EINVAL;
+}
+
+/* Reads an a{sv} filter, which may only use the keys in allowed */
+static int list_filters_read(DBusMessageIter *iter, unsigned allowed, DBusError *error, ListArgs *a) {
+        DBusMessageIter sub;
+        int r;
+
+        if (dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_ARRAY ||
+            dbus_message_iter_get_element_type(iter) != DBUS_TYPE_DICT_ENTRY)
+                return -EINVAL;
+
+        dbus_message_iter_recurse(iter, &sub);
+
+        while (dbus_message_iter_get_arg_type(&sub) == DBUS_TYPE_DICT_ENTRY) {
+                r = list_filter_read(&sub, allowed, error, a);
+                if (r < 0)
+                        return r;
+
+                dbus_message_iter_next(&sub);
+        }
+
+        return 0;
+}
+
+/* Reads the a{sv}su arguments of the Ex() methods */
+static int list_args_read(DBusMessage *message, bool ex, unsigned allowed, DBusError *error, ListArgs *a) {
+        DBusMessageIter iter;
+        int r;
+
+        zero(*a);
+        a->cursor = "";
+
+        if (!ex)
+                return 0;
+
+        if (!dbus_message_iter_init(message, &iter))
+                return -EINVAL;
+
+        r = list_filters_read(&iter, allowed, error, a);
+        if (r < 0)
+                return r;
+
+        if (!dbus_message_iter_next(&iter) ||
+            dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+                return -EINVAL;
+
+        dbus_message_iter_get_basic(&iter, &a->cursor);
+
+        if (!dbus_message_iter_next(&iter) ||
+            dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+                return -EINVAL;
+
+        dbus_message_iter_get_basic(&iter, &a->limit);
+
+        if (dbus_message_iter_next(&iter))
+                return -EINVAL;
+
+        return 0;
+}
+
+static int list_cursor_expired(DBusError *error, const char *cursor) {
+        dbus_set_error(error, BUS_ERROR_CURSOR_EXPIRED, "Cursor %s has expired", cursor);
+        return -ESTALE;
+}
+
+static int list_reply_new(DBusMessage *message, const char *signature, DBusMessage **reply, DBusMessageIter *iter, DBusMessageIter *sub) {
+        *reply = dbus_message_new_method_return(message);
+        if (!*reply)
+                return -ENOMEM;
+
+        dbus_message_iter_init_append(*reply, iter);
+
+        if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, signature, sub))
+                return -ENOMEM;
+
+        return 0;
+}
+
+/* Closes the array, and for the Ex() methods appends the cursor of
+ * the first entry that didn't fit */
+static int list_reply_finish(DBusMessageIter *iter, DBusMessageIter *sub, bool ex, const char *next) {
+        if (!dbus_message_iter_close_container(iter, sub))
+                return -ENOMEM;
+
+        if (ex && !dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &next))
+                return -ENOMEM;
+
+        return 0;
+}
+
+/* The object paths of all entries are formatted into the same
+ * buffer, rather than allocated one by one */
+static const char *list_path(char **buf, size_t *allocated, const char *prefix, const char *id) {
+        size_t l;
+
+        l = strlen(prefix);
+
+        if (!GREEDY_REALLOC(*buf, *allocated, l + BUS_PATH_ESCAPE_MAX(strlen(id))))
+                return NULL;
+
+        memcpy(*buf, prefix, l);
+        bus_path_escape_to(*buf + l, id);
+
+        return *buf;
+}
+
+static int session_list_state(const ListArgs *a, DBusError *error, SessionState *state) {
+        *state = _SESSION_STATE_INVALID;
+
+        if (!(a->set & LIST_FILTER_STATE))
+                return 0;
+
+        *state = session_state_from_string(a->state);
+        if (*state < 0) {
+                dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Invalid state filter %s", a->state);
+                return -EINVAL;
+        }
+
+        return 0;
+}
+
+static int user_list_state(const ListArgs *a, DBusError *error, UserState *state) {
+        *state = _USER_STATE_INVALID;
+
+        if (!(a->set & LIST_FILTER_STATE))
+                return 0;
+
+        *state = user_state_from_string(a->state);
+        if (*state < 0) {
+                dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Invalid state filter %s", a->state);
+                return -EINVAL;
+        }
+
+        return 0;
+}
+
+static bool session_list_match(Session *s, const ListArgs *a, SessionState state) {
+        if ((a->set & LIST_FILTER_UID) && s->user->uid != a->uid)
+                return false;
+
+        if ((a->set & LIST_FILTER_SEAT) && (!s->seat || !streq(s->seat->id, a->seat)))
+                return false;
+
+        if ((a->set & LIST_FILTER_CLASS) && s->class != a->class)
+                return false;
+
+        if ((a->set & LIST_FILTER_TYPE) && s->type != a->type)
+                return false;
+
+        if ((a->set & LIST_FILTER_STATE) && session_get_state(s) != state)
+                return false;
+
+        if ((a->set & LIST_FILTER_REMOTE) && s->remote != a->remote)
+                return false;
+
+        return true;
+}
+
+/* Picks the narrowest index the filter allows: the sessions of the
+ * user, those of the seat, or all of them. Returns false if the user
+ * or seat doesn't exist, and hence no session matches. */
+static bool session_list_index(Manager *m, const ListArgs *a, User **user, Seat **seat) {
+        *user = NULL;
+        *seat = NULL;
+
+        if (a->set & LIST_FILTER_UID) {
+                *user = hashmap_get(m->users, ULONG_TO_PTR((unsigned long) a->uid));
+                return !!*user;
+        }
+
+        if (a->set & LIST_FILTER_SEAT) {
+                *seat = hashmap_get(m->seats, a->seat);
+                return !!*seat;
+        }
+
+        return true;
+}
+
+static Session *session_list_next(Manager *m, User *user, Seat *seat, Session *s, Iterator *i) {
+        if (user)
+                return s ? s->sessions_by_user_next : user->sessions;
+
+        if (seat)
+                return s ? s->sessions_by_seat_next : seat->sessions;
+
+        return hashmap_iterate(m->sessions, i, NULL);
+}
+
+static int session_list_append(DBusMessageIter *sub, Session *s, const char *path) {
+        DBusMessageIter sub2;
+        dbus_uint32_t uid;
+        const char *seat;
+
+        uid = (dbus_uint32_t) s->user->uid;
+        seat = s->seat ? s->seat->id : "";
+
+        if (!dbus_message_iter_open_container(sub, DBUS_TYPE_STRUCT, NULL, &sub2) ||
+            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &s->id) ||
+            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
+            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &s->user->name) ||
+            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &seat) ||
+            !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &path) ||
+            !dbus_message_iter_close_container(sub, &sub2))
+                return -ENOMEM;
+
+        return 0;
+}
+
+int bus_manager_list_sessions(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply) {
+        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
+        _cleanup_free_ char *buf = NULL;
+        size_t allocated = 0;
+        DBusMessageIter iter, sub;
+        SessionState state;
+        const char *next = "";
+        User *user;
+        Seat *seat;
+        Session *session;
+        Iterator i = ITERATOR_FIRST;
+        ListArgs a;
+        uint32_t n = 0;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(_reply);
+
+        r = list_args_read(message, ex, SESSION_FILTERS, error, &a);
+        if (r < 0)
+                return r;
+
+        r = session_list_state(&a, error, &state);
+        if (r < 0)
+                return r;
+
+        r = list_reply_new(message, "(susso)", &reply, &iter, &sub);
+        if (r < 0)
+                return r;
+
+        if (!session_list_index(m, &a, &user, &seat))
+                goto finish;
+
+        if (isempty(a.cursor))
+                session = session_list_next(m, user, seat, NULL, &i);
+        else {
+                session = hashmap_get(m->sessions, a.cursor);
+                if (!session ||
+                    (user && session->user != user) ||
+                    (seat && session->seat != seat))
+                        return list_cursor_expired(error, a.cursor);
+
+                /* Continue the walk after the cursor */
+                if (!user && !seat) {
+                        hashmap_iterate_skip(m->sessions, a.cursor, &i);
+                        hashmap_iterate(m->sessions, &i, NULL);
+                }
+        }
+
+        for (; session; session = session_list_next(m, user, seat, session, &i)) {
+                const char *p;
+
+                if (!session_list_match(session, &a, state))
+                        continue;
+
+                if (a.limit > 0 && n >= a.limit) {
+                        next = session->id;
+                        break;
+                }
+
+                p = list_path(&buf, &allocated, "/org/freedesktop/login1/session/", session->id);
+                if (!p)
+                        return -ENOMEM;
+
+                r = session_list_append(&sub, session, p);
+                if (r < 0)
+                        return r;
+
+                n++;
+        }
+
+finish:
+        r = list_reply_finish(&iter, &sub, ex, next);
+        if (r < 0)
+                return r;
+
+        *_reply = reply;
+        reply = NULL;
+
+        return 0;
+}
+
+int bus_manager_list_users(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply) {
+        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
+        char p[sizeof("/org/freedesktop/login1/user/") + DECIMAL_STR_MAX(unsigned long long)];
+        char next[DECIMAL_STR_MAX(unsigned long long)] = "";
+        DBusMessageIter iter, sub;
+        UserState state;
+        User *user;
+        Iterator i = ITERATOR_FIRST;
+        ListArgs a;
+        uint32_t n = 0;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(_reply);
+
+        r = list_args_read(message, ex, USER_FILTERS, error, &a);
+        if (r < 0)
+                return r;
+
+        r = user_list_state(&a, error, &state);
+        if (r < 0)
+                return r;
+
+        if (!isempty(a.cursor)) {
+                uid_t uid;
+
+                if (parse_uid(a.cursor, &uid) < 0 ||
+                    !hashmap_iterate_skip(m->users, ULONG_TO_PTR((unsigned long) uid), &i))
+                        return list_cursor_expired(error, a.cursor);
+        }
+
+        r = list_reply_new(message, "(uso)", &reply, &iter, &sub);
+        if (r < 0)
+                return r;
+
+        while ((user = hashmap_iterate(m->users, &i, NULL))) {
+                DBusMessageIter sub2;
+                dbus_uint32_t uid;
+                const char *path = p;
+
+                if ((a.set & LIST_FILTER_STATE) && user_get_state(user) != state)
+                        continue;
+
+                if (a.limit > 0 && n >= a.limit) {
+                        snprintf(next, sizeof(next), "%llu", (unsigned long long) user->uid);
+                        break;
+                }
+
+                uid = (dbus_uint32_t) user->uid;
+                snprintf(p, sizeof(p), "/org/freedesktop/login1/user/%llu", (unsigned long long) user->uid);
+
+                if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &user->name) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &path) ||
+                    !dbus_message_iter_close_container(&sub, &sub2))
+                        return -ENOMEM;
+
+                n++;
+        }
+
+        r = list_reply_finish(&iter, &sub, ex, next);
+        if (r < 0)
+                return r;
+
+        *_reply = reply;
+        reply = NULL;
+
+        return 0;
+}
+
+int bus_manager_list_seats(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply) {
+        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
+        _cleanup_free_ char *buf = NULL;
+        size_t allocated = 0;
+        DBusMessageIter iter, sub;
+        const char *next = "";
+        Seat *seat;
+        Iterator i = ITERATOR_FIRST;
+        ListArgs a;
+        uint32_t n = 0;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(_reply);
+
+        r = list_args_read(message, ex, 0, error, &a);
+        if (r < 0)
+                return r;
+
+        if (!isempty(a.cursor) && !hashmap_iterate_skip(m->seats, a.cursor, &i))
+                return list_cursor_expired(error, a.cursor);
+
+        r = list_reply_new(message, "(so)", &reply, &iter, &sub);
+        if (r < 0)
+                return r;
+
+        while ((seat = hashmap_iterate(m->seats, &i, NULL))) {
+                DBusMessageIter sub2;
+                const char *p;
+
+                if (a.limit > 0 && n >= a.limit) {
+                        next = seat->id;
+                        break;
+                }
+
+                p = list_path(&buf, &allocated, "/org/freedesktop/login1/seat/", seat->id);
+                if (!p)
+                        return -ENOMEM;
+
+                if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &seat->id) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_OBJECT_PATH, &p) ||
+                    !dbus_message_iter_close_container(&sub, &sub2))
+                        return -ENOMEM;
+
+                n++;
+        }
+
+        r = list_reply_finish(&iter, &sub, ex, next);
+        if (r < 0)
+                return r;
+
+        *_reply = reply;
+        reply = NULL;
+
+        return 0;
+}
+
+int bus_manager_list_inhibitors(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply) {
+        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
+        DBusMessageIter iter, sub;
+        const char *next = "";
+        Inhibitor *inhibitor;
+        Iterator i = ITERATOR_FIRST;
+        ListArgs a;
+        uint32_t n = 0;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(_reply);
+
+        r = list_args_read(message, ex, INHIBITOR_FILTERS, error, &a);
+        if (r < 0)
+                return r;
+
+        if (!isempty(a.cursor) && !hashmap_iterate_skip(m->inhibitors, a.cursor, &i))
+                return list_cursor_expired(error, a.cursor);
+
+        r = list_reply_new(message, "(ssssuu)", &reply, &iter, &sub);
+        if (r < 0)
+                return r;
+
+        while ((inhibitor = hashmap_iterate(m->inhibitors, &i, NULL))) {
+                DBusMessageIter sub2;
+                dbus_uint32_t uid, pid;
+                const char *what, *who, *why, *mode;
+
+                if ((a.set & LIST_FILTER_UID) && inhibitor->uid != a.uid)
+                        continue;
+
+                if ((a.set & LIST_FILTER_WHAT) && !(inhibitor->what & a.what))
+                        continue;
+
+                if ((a.set & LIST_FILTER_MODE) && inhibitor->mode != a.mode)
+                        continue;
+
+                if (a.limit > 0 && n >= a.limit) {
+                        next = inhibitor->id;
+                        break;
+                }
+
+                what = strempty(inhibit_what_to_string(inhibitor->what));
+                who = strempty(inhibitor->who);
+                why = strempty(inhibitor->why);
+                mode = strempty(inhibit_mode_to_string(inhibitor->mode));
+                uid = (dbus_uint32_t) inhibitor->uid;
+                pid = (dbus_uint32_t) inhibitor->pid;
+
+                if (!dbus_message_iter_open_container(&sub, DBUS_TYPE_STRUCT, NULL, &sub2) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &what) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &who) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &why) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_STRING, &mode) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &uid) ||
+                    !dbus_message_iter_append_basic(&sub2, DBUS_TYPE_UINT32, &pid) ||
+                    !dbus_message_iter_close_container(&sub, &sub2))
+                        return -ENOMEM;
+
+                n++;
+        }
+
+        r = list_reply_finish(&iter, &sub, ex, next);
+        if (r < 0)
+                return r;
+
+        *_reply = reply;
+        reply = NULL;
+
+        return 0;
+}
+
+/* Opens the {oa{sa{sv}}} entry of an object, for the properties of
+ * interface to be appended to entry[2] */
+static int object_open(DBusMessageIter *sub, DBusMessageIter entry[3], const char *path, const char *interface) {
+        if (!dbus_message_iter_open_container(sub, DBUS_TYPE_DICT_ENTRY, NULL, &entry[0]) ||
+            !dbus_message_iter_append_basic(&entry[0], DBUS_TYPE_OBJECT_PATH, &path) ||
+            !dbus_message_iter_open_container(&entry[0], DBUS_TYPE_ARRAY, "{sa{sv}}", &entry[1]) ||
+            !dbus_message_iter_open_container(&entry[1], DBUS_TYPE_DICT_ENTRY, NULL, &entry[2]) ||
+            !dbus_message_iter_append_basic(&entry[2], DBUS_TYPE_STRING, &interface))
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int object_close(DBusMessageIter *sub, DBusMessageIter entry[3]) {
+        if (!dbus_message_iter_close_container(&entry[1], &entry[2]) ||
+            !dbus_message_iter_close_container(&entry[0], &entry[1]) ||
+            !dbus_message_iter_close_container(sub, &entry[0]))
+                return -ENOMEM;
+
+        return 0;
+}
+
+static int snapshot_sessions(Manager *m, DBusMessageIter *filter, DBusError *error, DBusMessageIter *sub) {
+        _cleanup_free_ char *buf = NULL;
+        size_t allocated = 0;
+        SessionState state;
+        Session *session;
+        Iterator i = ITERATOR_FIRST;
+        User *user;
+        Seat *seat;
+        ListArgs a = {};
+        int r;
+
+        r = list_filters_read(filter, SESSION_FILTERS, error, &a);
+        if (r < 0)
+                return r;
+
+        r = session_list_state(&a, error, &state);
+        if (r < 0)
+                return r;
+
+        if (!session_list_index(m, &a, &user, &seat))
+                return 0;
+
+        for (session = session_list_next(m, user, seat, NULL, &i); session; session = session_list_next(m, user, seat, session, &i)) {
+                DBusMessageIter entry[3];
+                const char *p;
+
+                if (!session_list_match(session, &a, state))
+                        continue;
+
+                p = list_path(&buf, &allocated, "/org/freedesktop/login1/session/", session->id);
+                if (!p)
+                        return -ENOMEM;
+
+                r = object_open(sub, entry, p, "org.freedesktop.login1.Session");
+                if (r < 0)
+                        return r;
+
+                r = session_append_properties(session, &entry[2]);
+                if (r < 0)
+                        return r;
+
+                r = object_close(sub, entry);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int snapshot_users(Manager *m, DBusMessageIter *filter, DBusError *error, DBusMessageIter *sub) {
+        char p[sizeof("/org/freedesktop/login1/user/") + DECIMAL_STR_MAX(unsigned long long)];
+        UserState state;
+        User *user;
+        Iterator i;
+        ListArgs a = {};
+        int r;
+
+        r = list_filters_read(filter, USER_FILTERS, error, &a);
+        if (r < 0)
+                return r;
+
+        r = user_list_state(&a, error, &state);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH(user, m->users, i) {
+                DBusMessageIter entry[3];
+
+                if ((a.set & LIST_FILTER_STATE) && user_get_state(user) != state)
+                        continue;
+
+                snprintf(p, sizeof(p), "/org/freedesktop/login1/user/%llu", (unsigned long long) user->uid);
+
+                r = object_open(sub, entry, p, "org.freedesktop.login1.User");
+                if (r < 0)
+                        return r;
+
+                r = user_append_properties(user, &entry[2]);
+                if (r < 0)
+                        return r;
+
+                r = object_close(sub, entry);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int snapshot_seats(Manager *m, DBusMessageIter *filter, DBusError *error, DBusMessageIter *sub) {
+        _cleanup_free_ char *buf = NULL;
+        size_t allocated = 0;
+        Seat *seat;
+        Iterator i;
+        ListArgs a = {};
+        int r;
+
+        r = list_filters_read(filter, 0, error, &a);
+        if (r < 0)
+                return r;
+
+        HASHMAP_FOREACH(seat, m->seats, i) {
+                DBusMessageIter entry[3];
+                const char *p;
+
+                p = list_path(&buf, &allocated, "/org/freedesktop/login1/seat/", seat->id);
+                if (!p)
+                        return -ENOMEM;
+
+                r = object_open(sub, entry, p, "org.freedesktop.login1.Seat");
+                if (r < 0)
+                        return r;
+
+                r = seat_append_properties(seat, &entry[2]);
+                if (r < 0)
+                        return r;
+
+                r = object_close(sub, entry);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+int bus_manager_get_object_properties(Manager *m, DBusMessage *message, DBusError *error, DBusMessage **_reply) {
+        _cleanup_dbus_message_unref_ DBusMessage *reply = NULL;
+        DBusMessageIter filter, iter, sub;
+        const char *kind;
+        int r;
+
+        assert(m);
+        assert(message);
+        assert(_reply);
+
+        if (!dbus_message_has_signature(message, "sa{sv}"))
+                return -EINVAL;
+
+        assert_se(dbus_message_iter_init(message, &filter));
+        dbus_message_iter_get_basic(&filter, &kind);
+        dbus_message_iter_next(&filter);
+
+        r = list_reply_new(message, "{oa{sa{sv}}}", &reply, &iter, &sub);
+        if (r < 0)
+                return r;
+
+        if (streq(kind, "session"))
+                r = snapshot_sessions(m, &filter, error, &sub);
+        else if (streq(kind, "user"))
+                r = snapshot_users(m, &filter, error, &sub);
+        else if (streq(kind, "seat"))
+                r = snapshot_seats(m, &filter, error, &sub);
+        else {
+                dbus_set_error(error, DBUS_ERROR_INVALID_ARGS, "Unknown object kind %s", kind);
+                r = -EINVAL;
+        }
+        if (r < 0)
+                return r;
+
+        if (!dbus_message_iter_close_container(&iter, &sub))
+                return -ENOMEM;
+
+        *_reply = reply;
+        reply = NULL;
+
+        return 0;
+}
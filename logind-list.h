@@ -0,0 +1,44 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stdbool.h>
+#include <dbus/dbus.h>
+
+#include "logind.h"
+
+#define BUS_ERROR_CURSOR_EXPIRED "org.freedesktop.login1.CursorExpired"
+
+/* The replies of ListSessions(), ListUsers(), ListSeats() and
+ * ListInhibitors(), and of their Ex() variants. These take a filter
+ * as a{sv}, a cursor and a limit, and return at most limit entries
+ * matching the filter, starting with the one the cursor names, plus
+ * the cursor for the next call, which is empty after the last
+ * entry. A cursor names an object, and expires with it. */
+
+int bus_manager_list_sessions(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply);
+int bus_manager_list_users(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply);
+int bus_manager_list_seats(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply);
+int bus_manager_list_inhibitors(Manager *m, DBusMessage *message, bool ex, DBusError *error, DBusMessage **_reply);
+
+/* The reply of GetObjectProperties(), the properties of all sessions,
+ * users or seats matching the filter, as GetAll() would return them
+ * for each, in a{oa{sa{sv}}} */
+int bus_manager_get_object_properties(Manager *m, DBusMessage *message, DBusError *error, DBusMessage **_reply);
@@ -0,0 +1,60 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <string.h>
+
+#include "util.h"
+#include "logind-method.h"
+
+const struct LogindMethod *logind_method_find(DBusMessage *message) {
+        const char *interface, *member;
+        size_t a, b;
+        char *key;
+
+        assert(message);
+
+        if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+                return NULL;
+
+        interface = dbus_message_get_interface(message);
+        member = dbus_message_get_member(message);
+        if (!interface || !member)
+                return NULL;
+
+        a = strlen(interface);
+        b = strlen(member);
+
+        key = alloca(a + 1 + b + 1);
+        memcpy(key, interface, a);
+        key[a] = '.';
+        memcpy(key + a + 1, member, b + 1);
+
+        return logind_method_lookup(key, a + 1 + b);
+}
+
+int logind_method_from_message(DBusMessage *message, LogindObject object) {
+        const struct LogindMethod *m;
+
+        m = logind_method_find(message);
+        if (!m || m->object != object)
+                return -1;
+
+        return m->method;
+}
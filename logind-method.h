@@ -0,0 +1,125 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <dbus/dbus.h>
+
+/* Method calls handled by the message handlers of the manager, seat,
+ * session and user objects. The handlers switch over the values
+ * below, which logind_method_from_message() looks up in a perfect
+ * hash table generated from logind-method-gperf.gperf, keyed by
+ * interface and member. */
+
+typedef enum LogindObject {
+        LOGIND_OBJECT_MANAGER,
+        LOGIND_OBJECT_SEAT,
+        LOGIND_OBJECT_SESSION,
+        LOGIND_OBJECT_USER
+} LogindObject;
+
+typedef enum ManagerMethod {
+        MANAGER_METHOD_GET_SESSION,
+        MANAGER_METHOD_GET_SESSION_BY_PID,
+        MANAGER_METHOD_GET_USER,
+        MANAGER_METHOD_GET_SEAT,
+        MANAGER_METHOD_LIST_SESSIONS,
+        MANAGER_METHOD_LIST_USERS,
+        MANAGER_METHOD_LIST_SEATS,
+        MANAGER_METHOD_LIST_INHIBITORS,
+        MANAGER_METHOD_LIST_SESSIONS_EX,
+        MANAGER_METHOD_LIST_USERS_EX,
+        MANAGER_METHOD_LIST_SEATS_EX,
+        MANAGER_METHOD_LIST_INHIBITORS_EX,
+        MANAGER_METHOD_GET_OBJECT_PROPERTIES,
+        MANAGER_METHOD_INHIBIT,
+        MANAGER_METHOD_CREATE_SESSION,
+        MANAGER_METHOD_RELEASE_SESSION,
+        MANAGER_METHOD_ACTIVATE_SESSION,
+        MANAGER_METHOD_ACTIVATE_SESSION_ON_SEAT,
+        MANAGER_METHOD_LOCK_SESSION,
+        MANAGER_METHOD_UNLOCK_SESSION,
+        MANAGER_METHOD_LOCK_SESSIONS,
+        MANAGER_METHOD_UNLOCK_SESSIONS,
+        MANAGER_METHOD_KILL_SESSION,
+        MANAGER_METHOD_KILL_USER,
+        MANAGER_METHOD_TERMINATE_SESSION,
+        MANAGER_METHOD_TERMINATE_USER,
+        MANAGER_METHOD_TERMINATE_SEAT,
+        MANAGER_METHOD_SET_USER_LINGER,
+        MANAGER_METHOD_ATTACH_DEVICE,
+        MANAGER_METHOD_FLUSH_DEVICES,
+        MANAGER_METHOD_POWER_OFF,
+        MANAGER_METHOD_REBOOT,
+        MANAGER_METHOD_SUSPEND,
+        MANAGER_METHOD_HIBERNATE,
+        MANAGER_METHOD_HYBRID_SLEEP,
+        MANAGER_METHOD_CAN_POWER_OFF,
+        MANAGER_METHOD_CAN_REBOOT,
+        MANAGER_METHOD_CAN_SUSPEND,
+        MANAGER_METHOD_CAN_HIBERNATE,
+        MANAGER_METHOD_CAN_HYBRID_SLEEP,
+        MANAGER_METHOD_GET_STATS,
+        MANAGER_METHOD_RESET_STATS,
+        MANAGER_METHOD_INTROSPECT,
+        _MANAGER_METHOD_MAX,
+        _MANAGER_METHOD_INVALID = -1
+} ManagerMethod;
+
+typedef enum SeatMethod {
+        SEAT_METHOD_TERMINATE,
+        SEAT_METHOD_ACTIVATE_SESSION,
+        _SEAT_METHOD_MAX,
+        _SEAT_METHOD_INVALID = -1
+} SeatMethod;
+
+typedef enum SessionMethod {
+        SESSION_METHOD_TERMINATE,
+        SESSION_METHOD_ACTIVATE,
+        SESSION_METHOD_LOCK,
+        SESSION_METHOD_UNLOCK,
+        SESSION_METHOD_SET_IDLE_HINT,
+        SESSION_METHOD_KILL,
+        _SESSION_METHOD_MAX,
+        _SESSION_METHOD_INVALID = -1
+} SessionMethod;
+
+typedef enum UserMethod {
+        USER_METHOD_TERMINATE,
+        USER_METHOD_KILL,
+        _USER_METHOD_MAX,
+        _USER_METHOD_INVALID = -1
+} UserMethod;
+
+struct LogindMethod {
+        const char *name;
+        LogindObject object;
+        int method;
+};
+
+const struct LogindMethod *logind_method_lookup(const char *key, unsigned length);
+
+/* Returns the table entry of the method that message calls, of any
+ * object, or NULL */
+const struct LogindMethod *logind_method_find(DBusMessage *message);
+
+/* Returns the method of the given object that message calls, or -1
+ * if it isn't a method call we handle ourselves */
+int logind_method_from_message(DBusMessage *message, LogindObject object);
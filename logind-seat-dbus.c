@@ -25,6 +25,7 @@
 #include "logind.h"
 #include "logind-seat.h"
 #include "dbus-common.h"
+#include "logind-method.h"
 #include "util.h"
 
 #define BUS_SEAT_INTERFACE \
@@ -246,6 +247,18 @@ static const BusProperty bus_login_seat_properties[] = {
         { NULL, }
 };
 
+int seat_append_properties(Seat *s, DBusMessageIter *i) {
+        const BusBoundProperties bps[] = {
+                { "org.freedesktop.login1.Seat", bus_login_seat_properties, s },
+                { NULL, }
+        };
+
+        assert(s);
+        assert(i);
+
+        return bus_append_properties(i, bps, NULL);
+}
+
 static DBusHandlerResult seat_message_dispatch(
                 Seat *s,
                 DBusConnection *connection,
@@ -261,7 +274,9 @@ static DBusHandlerResult seat_message_dispatch(
 
         dbus_error_init(&error);
 
-        if (dbus_message_is_method_call(message, "org.freedesktop.login1.Seat", "Terminate")) {
+        switch (logind_method_from_message(message, LOGIND_OBJECT_SEAT)) {
+
+        case SEAT_METHOD_TERMINATE: {
 
                 r = seat_stop_sessions(s);
                 if (r < 0)
@@ -271,7 +286,10 @@ static DBusHandlerResult seat_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Seat", "ActivateSession")) {
+                break;
+        }
+
+        case SEAT_METHOD_ACTIVATE_SESSION: {
                 const char *name;
                 Session *session;
 
@@ -293,13 +311,18 @@ static DBusHandlerResult seat_message_dispatch(
                 reply = dbus_message_new_method_return(message);
                 if (!reply)
                         goto oom;
-        } else {
+
+                break;
+        }
+
+        default: {
                 const BusBoundProperties bps[] = {
                         { "org.freedesktop.login1.Seat", bus_login_seat_properties, s },
                         { NULL, }
                 };
                 return bus_default_message_handler(connection, message, INTROSPECTION, INTERFACES_LIST, bps);
         }
+        }
 
         if (reply) {
                 if (!bus_maybe_send_reply(connection, message, reply))
@@ -34,6 +34,9 @@
 #include "util.h"
 #include "mkdir.h"
 #include "path-util.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(seat_pool, Seat, 64);
 
 Seat *seat_new(Manager *m, const char *id) {
         Seat *s;
@@ -41,13 +44,13 @@ Seat *seat_new(Manager *m, const char *id) {
         assert(m);
         assert(id);
 
-        s = new0(Seat, 1);
+        s = mempool_alloc0_tile(&seat_pool);
         if (!s)
                 return NULL;
 
         s->state_file = strappend("/run/systemd/seats/", id);
         if (!s->state_file) {
-                free(s);
+                mempool_free_tile(&seat_pool, s);
                 return NULL;
         }
 
@@ -56,7 +59,7 @@ Seat *seat_new(Manager *m, const char *id) {
 
         if (hashmap_put(m->seats, s->id, s) < 0) {
                 free(s->state_file);
-                free(s);
+                mempool_free_tile(&seat_pool, s);
                 return NULL;
         }
 
@@ -66,8 +69,10 @@ Seat *seat_new(Manager *m, const char *id) {
 void seat_free(Seat *s) {
         assert(s);
 
-        if (s->in_gc_queue)
+        if (s->in_gc_queue) {
                 LIST_REMOVE(Seat, gc_queue, s->manager->seat_gc_queue, s);
+                s->manager->n_gc_queue--;
+        }
 
         while (s->sessions)
                 session_free(s->sessions);
@@ -80,19 +85,22 @@ void seat_free(Seat *s) {
         hashmap_remove(s->manager->seats, s->id);
 
         free(s->state_file);
-        free(s);
+        mempool_free_tile(&seat_pool, s);
 }
 
 int seat_save(Seat *s) {
         int r;
         FILE *f;
         char *temp_path;
+        usec_t start;
 
         assert(s);
 
         if (!s->started)
                 return 0;
 
+        start = now(CLOCK_MONOTONIC);
+
         r = mkdir_safe_label("/run/systemd/seats", 0755, 0, 0);
         if (r < 0)
                 goto finish;
@@ -155,6 +163,8 @@ int seat_save(Seat *s) {
         free(temp_path);
 
 finish:
+        stats_record_since(&s->manager->stats, STATS_SAVE, start);
+
         if (r < 0)
                 log_error("Failed to save seat data for %s: %s", s->id, strerror(-r));
 
@@ -218,16 +228,21 @@ int seat_preallocate_vts(Seat *s) {
 }
 
 int seat_apply_acls(Seat *s, Session *old_active) {
+        usec_t start;
         int r;
 
         assert(s);
 
+        start = now(CLOCK_MONOTONIC);
+
         r = devnode_acl_all(s->manager->udev,
                             s->id,
                             false,
                             !!old_active, old_active ? old_active->user->uid : 0,
                             !!s->active, s->active ? s->active->user->uid : 0);
 
+        stats_record_since(&s->manager->stats, STATS_ACL, start);
+
         if (r < 0)
                 log_error("Failed to apply ACLs: %s", strerror(-r));
 
@@ -246,6 +261,10 @@ int seat_set_active(Seat *s, Session *session) {
         old_active = s->active;
         s->active = session;
 
+        /* polkit decisions usually depend on whether the subject's
+         * session is active */
+        polkit_cache_flush(&s->manager->polkit_cache);
+
         seat_apply_acls(s, old_active);
 
         if (session && session->started)
@@ -510,6 +529,7 @@ void seat_add_to_gc_queue(Seat *s) {
 
         LIST_PREPEND(Seat, gc_queue, s->manager->seat_gc_queue, s);
         s->in_gc_queue = true;
+        s->manager->n_gc_queue++;
 }
 
 static bool seat_name_valid_char(char c) {
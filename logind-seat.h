@@ -76,6 +76,7 @@ void seat_add_to_gc_queue(Seat *s);
 
 bool seat_name_is_valid(const char *name);
 char *seat_bus_path(Seat *s);
+int seat_append_properties(Seat *s, DBusMessageIter *i);
 
 extern const DBusObjectPathVTable bus_seat_vtable;
 
@@ -25,6 +25,7 @@
 #include "logind.h"
 #include "logind-session.h"
 #include "dbus-common.h"
+#include "logind-method.h"
 #include "util.h"
 
 #define BUS_SESSION_INTERFACE \
@@ -291,6 +292,24 @@ static const BusProperty bus_login_session_user_properties[] = {
         { NULL, }
 };
 
+int session_append_properties(Session *s, DBusMessageIter *i) {
+        const BusBoundProperties bps[] = {
+                { "org.freedesktop.login1.Session", bus_login_session_properties,      s       },
+                { "org.freedesktop.login1.Session", bus_login_session_user_properties, s->user },
+                { NULL, }
+        };
+
+        assert(s);
+        assert(i);
+
+        return bus_append_properties(i, bps, NULL);
+}
+
+static DBusHandlerResult session_message_handler(
+                DBusConnection *connection,
+                DBusMessage *message,
+                void *userdata);
+
 static DBusHandlerResult session_message_dispatch(
                 Session *s,
                 DBusConnection *connection,
@@ -306,7 +325,9 @@ static DBusHandlerResult session_message_dispatch(
 
         dbus_error_init(&error);
 
-        if (dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "Terminate")) {
+        switch (logind_method_from_message(message, LOGIND_OBJECT_SESSION)) {
+
+        case SESSION_METHOD_TERMINATE: {
 
                 r = session_stop(s);
                 if (r < 0)
@@ -316,7 +337,10 @@ static DBusHandlerResult session_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "Activate")) {
+                break;
+        }
+
+        case SESSION_METHOD_ACTIVATE: {
 
                 r = session_activate(s);
                 if (r < 0)
@@ -326,8 +350,11 @@ static DBusHandlerResult session_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "Lock") ||
-                   dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "Unlock")) {
+                break;
+        }
+
+        case SESSION_METHOD_LOCK:
+        case SESSION_METHOD_UNLOCK: {
 
                 if (session_send_lock(s, streq(dbus_message_get_member(message), "Lock")) < 0)
                         goto oom;
@@ -336,9 +363,12 @@ static DBusHandlerResult session_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "SetIdleHint")) {
+                break;
+        }
+
+        case SESSION_METHOD_SET_IDLE_HINT: {
                 dbus_bool_t b;
-                unsigned long ul;
+                const BusCreds *creds;
 
                 if (!dbus_message_get_args(
                                     message,
@@ -347,11 +377,14 @@ static DBusHandlerResult session_message_dispatch(
                                     DBUS_TYPE_INVALID))
                         return bus_send_error_reply(connection, message, &error, -EINVAL);
 
-                ul = dbus_bus_get_unix_user(connection, dbus_message_get_sender(message), &error);
-                if (ul == (unsigned long) -1)
-                        return bus_send_error_reply(connection, message, &error, -EIO);
+                r = bus_creds_get_async(&s->manager->creds, connection, message, &creds,
+                                        session_message_handler, s->manager);
+                if (r == -EINPROGRESS)
+                        break;
+                if (r < 0)
+                        return bus_send_error_reply(connection, message, NULL, r);
 
-                if (ul != 0 && ul != s->user->uid)
+                if (creds->uid != 0 && creds->uid != s->user->uid)
                         return bus_send_error_reply(connection, message, NULL, -EPERM);
 
                 session_set_idle_hint(s, b);
@@ -360,7 +393,10 @@ static DBusHandlerResult session_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.Session", "Kill")) {
+                break;
+        }
+
+        case SESSION_METHOD_KILL: {
                 const char *swho;
                 int32_t signo;
                 KillWho who;
@@ -392,7 +428,10 @@ static DBusHandlerResult session_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else {
+                break;
+        }
+
+        default: {
                 const BusBoundProperties bps[] = {
                         { "org.freedesktop.login1.Session", bus_login_session_properties,      s       },
                         { "org.freedesktop.login1.Session", bus_login_session_user_properties, s->user },
@@ -400,6 +439,7 @@ static DBusHandlerResult session_message_dispatch(
                 };
                 return bus_default_message_handler(connection, message, INTROSPECTION, INTERFACES_LIST, bps);
         }
+        }
 
         if (reply) {
                 if (!bus_maybe_send_reply(connection, message, reply))
@@ -495,7 +535,8 @@ int session_send_changed(Session *s, const char *properties) {
 
         assert(s);
 
-        if (!s->started)
+        /* Nothing changed before SessionNew was sent */
+        if (!s->started || s->in_setup_queue)
                 return 0;
 
         p = session_bus_path(s);
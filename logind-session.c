@@ -34,6 +34,9 @@
 #include "cgroup-util.h"
 #include "logind-session.h"
 #include "fileio.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(session_pool, Session, 64);
 
 Session* session_new(Manager *m, User *u, const char *id) {
         Session *s;
@@ -41,13 +44,13 @@ Session* session_new(Manager *m, User *u, const char *id) {
         assert(m);
         assert(id);
 
-        s = new0(Session, 1);
+        s = mempool_alloc0_tile(&session_pool);
         if (!s)
                 return NULL;
 
         s->state_file = strappend("/run/systemd/sessions/", id);
         if (!s->state_file) {
-                free(s);
+                mempool_free_tile(&session_pool, s);
                 return NULL;
         }
 
@@ -55,7 +58,7 @@ Session* session_new(Manager *m, User *u, const char *id) {
 
         if (hashmap_put(m->sessions, s->id, s) < 0) {
                 free(s->state_file);
-                free(s);
+                mempool_free_tile(&session_pool, s);
                 return NULL;
         }
 
@@ -68,11 +71,50 @@ Session* session_new(Manager *m, User *u, const char *id) {
         return s;
 }
 
+static void session_add_to_setup_queue(Session *s) {
+        Manager *m;
+
+        assert(s);
+        assert(!s->in_setup_queue);
+
+        m = s->manager;
+
+        /* Appended, so that sessions are announced in the order they
+         * were created in */
+        LIST_INSERT_AFTER(Session, setup_queue, m->session_setup_queue, m->session_setup_queue_tail, s);
+        m->session_setup_queue_tail = s;
+
+        s->in_setup_queue = true;
+        s->setup_stage = 0;
+        s->setup_start = now(CLOCK_MONOTONIC);
+}
+
+static void session_remove_from_setup_queue(Session *s) {
+        Manager *m;
+
+        assert(s);
+
+        if (!s->in_setup_queue)
+                return;
+
+        m = s->manager;
+
+        if (m->session_setup_queue_tail == s)
+                m->session_setup_queue_tail = s->setup_queue_prev;
+
+        LIST_REMOVE(Session, setup_queue, m->session_setup_queue, s);
+        s->in_setup_queue = false;
+}
+
 void session_free(Session *s) {
         assert(s);
 
-        if (s->in_gc_queue)
+        if (s->in_gc_queue) {
                 LIST_REMOVE(Session, gc_queue, s->manager->session_gc_queue, s);
+                s->manager->n_gc_queue--;
+        }
+
+        session_remove_from_setup_queue(s);
 
         if (s->user) {
                 LIST_REMOVE(Session, sessions_by_user, s->user->sessions, s);
@@ -89,34 +131,38 @@ void session_free(Session *s) {
         }
 
         if (s->cgroup_path)
-                hashmap_remove(s->manager->session_cgroups, s->cgroup_path);
+                manager_cgroup_unmap_session(s->manager, s->cgroup_path, s);
 
         free(s->cgroup_path);
-        strv_free(s->controllers);
+        intern_strv_unref(&s->manager->interned, s->controllers);
+        intern_strv_unref(&s->manager->interned, s->reset_controllers);
 
-        free(s->tty);
-        free(s->display);
-        free(s->remote_host);
-        free(s->remote_user);
-        free(s->service);
+        intern_string_unref(&s->manager->interned, s->tty);
+        intern_string_unref(&s->manager->interned, s->display);
+        intern_string_unref(&s->manager->interned, s->remote_host);
+        intern_string_unref(&s->manager->interned, s->remote_user);
+        intern_string_unref(&s->manager->interned, s->service);
 
         hashmap_remove(s->manager->sessions, s->id);
         session_remove_fifo(s);
 
         free(s->state_file);
-        free(s);
+        mempool_free_tile(&session_pool, s);
 }
 
 int session_save(Session *s) {
         FILE *f;
         int r = 0;
         char *temp_path;
+        usec_t start;
 
         assert(s);
 
         if (!s->started)
                 return 0;
 
+        start = now(CLOCK_MONOTONIC);
+
         r = mkdir_safe_label("/run/systemd/sessions", 0755, 0, 0);
         if (r < 0)
                 goto finish;
@@ -221,12 +267,33 @@ int session_save(Session *s) {
         free(temp_path);
 
 finish:
+        stats_record_since(&s->manager->stats, STATS_SAVE, start);
+
         if (r < 0)
                 log_error("Failed to save session data for %s: %s", s->id, strerror(-r));
 
         return r;
 }
 
+int session_set_string(Session *s, const char **field, const char *value) {
+        const char *v = NULL;
+        int r;
+
+        assert(s);
+        assert(field);
+
+        if (!isempty(value)) {
+                r = intern_string(&s->manager->interned, value, &v);
+                if (r < 0)
+                        return r;
+        }
+
+        intern_string_unref(&s->manager->interned, *field);
+        *field = v;
+
+        return 0;
+}
+
 int session_load(Session *s) {
         char *remote = NULL,
                 *kill_processes = NULL,
@@ -235,7 +302,12 @@ int session_load(Session *s) {
                 *leader = NULL,
                 *audit_id = NULL,
                 *type = NULL,
-                *class = NULL;
+                *class = NULL,
+                *tty = NULL,
+                *display = NULL,
+                *remote_host = NULL,
+                *remote_user = NULL,
+                *service = NULL;
 
         int k, r;
 
@@ -247,11 +319,11 @@ int session_load(Session *s) {
                            "CGROUP",         &s->cgroup_path,
                            "FIFO",           &s->fifo_path,
                            "SEAT",           &seat,
-                           "TTY",            &s->tty,
-                           "DISPLAY",        &s->display,
-                           "REMOTE_HOST",    &s->remote_host,
-                           "REMOTE_USER",    &s->remote_user,
-                           "SERVICE",        &s->service,
+                           "TTY",            &tty,
+                           "DISPLAY",        &display,
+                           "REMOTE_HOST",    &remote_host,
+                           "REMOTE_USER",    &remote_user,
+                           "SERVICE",        &service,
                            "VTNR",           &vtnr,
                            "LEADER",         &leader,
                            "TYPE",           &type,
@@ -261,6 +333,13 @@ int session_load(Session *s) {
         if (r < 0)
                 goto finish;
 
+        if ((r = session_set_string(s, &s->tty, tty)) < 0 ||
+            (r = session_set_string(s, &s->display, display)) < 0 ||
+            (r = session_set_string(s, &s->remote_host, remote_host)) < 0 ||
+            (r = session_set_string(s, &s->remote_user, remote_user)) < 0 ||
+            (r = session_set_string(s, &s->service, service)) < 0)
+                goto finish;
+
         if (remote) {
                 k = parse_boolean(remote);
                 if (k >= 0)
@@ -332,6 +411,11 @@ finish:
         free(leader);
         free(audit_id);
         free(class);
+        free(tty);
+        free(display);
+        free(remote_host);
+        free(remote_user);
+        free(service);
 
         return r;
 }
@@ -456,7 +540,6 @@ static int session_create_one_group(Session *s, const char *controller, const ch
 }
 
 static int session_create_cgroup(Session *s) {
-        char **k;
         char *p;
         int r;
 
@@ -491,26 +574,45 @@ static int session_create_cgroup(Session *s) {
 
         s->cgroup_path = p;
 
+        r = manager_cgroup_map_session(s->manager, s->cgroup_path, s);
+        if (r < 0)
+                log_warning("Failed to create mapping between cgroup and session");
+
+        return 0;
+}
+
+/* The groups in all other hierarchies only matter for resource
+ * control, hence they are left for after CreateSession() has been
+ * answered */
+static void session_create_extra_cgroups(Session *s) {
+        char **k;
+        int r;
+
+        assert(s);
+
+        if (!s->cgroup_path)
+                return;
+
         STRV_FOREACH(k, s->controllers) {
 
-                if (strv_contains(s->reset_controllers, *k))
+                if (intern_strv_contains(s->reset_controllers, *k))
                         continue;
 
-                r = session_create_one_group(s, *k, p);
+                r = session_create_one_group(s, *k, s->cgroup_path);
                 if (r < 0)
-                        log_warning("Failed to create %s:%s: %s", *k, p, strerror(-r));
+                        log_warning("Failed to create %s:%s: %s", *k, s->cgroup_path, strerror(-r));
         }
 
         STRV_FOREACH(k, s->manager->controllers) {
 
-                if (strv_contains(s->reset_controllers, *k) ||
-                    strv_contains(s->manager->reset_controllers, *k) ||
-                    strv_contains(s->controllers, *k))
+                if (intern_strv_contains(s->reset_controllers, *k) ||
+                    intern_strv_contains(s->manager->reset_controllers, *k) ||
+                    intern_strv_contains(s->controllers, *k))
                         continue;
 
-                r = session_create_one_group(s, *k, p);
+                r = session_create_one_group(s, *k, s->cgroup_path);
                 if (r < 0)
-                        log_warning("Failed to create %s:%s: %s", *k, p, strerror(-r));
+                        log_warning("Failed to create %s:%s: %s", *k, s->cgroup_path, strerror(-r));
         }
 
         if (s->leader > 0) {
@@ -524,8 +626,8 @@ static int session_create_cgroup(Session *s) {
 
                 STRV_FOREACH(k, s->manager->reset_controllers) {
 
-                        if (strv_contains(s->reset_controllers, *k) ||
-                            strv_contains(s->controllers, *k))
+                        if (intern_strv_contains(s->reset_controllers, *k) ||
+                            intern_strv_contains(s->controllers, *k))
                                 continue;
 
                         r = cg_attach(*k, "/", s->leader);
@@ -534,12 +636,6 @@ static int session_create_cgroup(Session *s) {
 
                 }
         }
-
-        r = hashmap_put(s->manager->session_cgroups, s->cgroup_path, s);
-        if (r < 0)
-                log_warning("Failed to create mapping between cgroup and session");
-
-        return 0;
 }
 
 int session_start(Session *s) {
@@ -573,20 +669,30 @@ int session_start(Session *s) {
 
         dual_timestamp_get(&s->timestamp);
 
+        s->started = true;
+
+        /* The rest is done by the main loop, once the caller has
+         * been answered */
+        session_add_to_setup_queue(s);
+
+        return 0;
+}
+
+static void session_setup_save(Session *s) {
         if (s->seat)
                 seat_read_active_vt(s->seat);
 
-        s->started = true;
-
-        /* Save session data */
         session_save(s);
         user_save(s->user);
 
+        if (s->seat)
+                seat_save(s->seat);
+}
+
+static void session_setup_signals(Session *s) {
         session_send_signal(s, true);
 
         if (s->seat) {
-                seat_save(s->seat);
-
                 if (s->seat->active == s)
                         seat_send_changed(s->seat, "Sessions\0ActiveSession\0");
                 else
@@ -594,8 +700,41 @@ int session_start(Session *s) {
         }
 
         user_send_changed(s->user, "Sessions\0");
+}
 
-        return 0;
+static void (* const session_setup_table[_SESSION_SETUP_STAGE_MAX])(Session *s) = {
+        [SESSION_SETUP_CONTROLLERS] = session_create_extra_cgroups,
+        [SESSION_SETUP_SAVE] = session_setup_save,
+        [SESSION_SETUP_SIGNALS] = session_setup_signals,
+};
+
+static const StatsSource session_setup_stats_source[_SESSION_SETUP_STAGE_MAX] = {
+        [SESSION_SETUP_CONTROLLERS] = STATS_SESSION_CONTROLLERS,
+        [SESSION_SETUP_SAVE] = STATS_SESSION_SAVE,
+        [SESSION_SETUP_SIGNALS] = STATS_SESSION_SIGNALS,
+};
+
+/* Runs the next setup stage of the session, returns true once all of
+ * them are done and the session has left the queue */
+bool session_dispatch_setup(Session *s) {
+        usec_t start;
+
+        assert(s);
+        assert(s->in_setup_queue);
+        assert(s->setup_stage < _SESSION_SETUP_STAGE_MAX);
+
+        start = now(CLOCK_MONOTONIC);
+        session_setup_table[s->setup_stage](s);
+        start = stats_record_since(&s->manager->stats, session_setup_stats_source[s->setup_stage], start);
+
+        s->setup_stage++;
+        if (s->setup_stage < _SESSION_SETUP_STAGE_MAX)
+                return false;
+
+        stats_record(&s->manager->stats, STATS_SESSION_SETUP, start - s->setup_start);
+        session_remove_from_setup_queue(s);
+
+        return true;
 }
 
 static bool session_shall_kill(Session *s) {
@@ -661,7 +800,7 @@ static int session_terminate_cgroup(Session *s) {
         STRV_FOREACH(k, s->user->manager->controllers)
                 cg_trim(*k, s->cgroup_path, true);
 
-        hashmap_remove(s->manager->session_cgroups, s->cgroup_path);
+        manager_cgroup_unmap_session(s->manager, s->cgroup_path, s);
 
         free(s->cgroup_path);
         s->cgroup_path = NULL;
@@ -705,6 +844,13 @@ int session_stop(Session *s) {
                            "MESSAGE=Removed session %s.", s->id,
                            NULL);
 
+        /* Whoever saw the session go must have seen it come, but its
+         * cgroups and state files are about to go anyway */
+        if (s->in_setup_queue) {
+                s->setup_stage = SESSION_SETUP_SIGNALS;
+                session_dispatch_setup(s);
+        }
+
         /* Kill cgroup */
         k = session_terminate_cgroup(s);
         if (k < 0)
@@ -914,7 +1060,7 @@ int session_create_fifo(Session *s) {
                 if (s->fifo_fd < 0)
                         return -errno;
 
-                r = hashmap_put(s->manager->session_fds, INT_TO_PTR(s->fifo_fd + 1), s);
+                r = manager_add_fd_object(s->manager, s->fifo_fd, FD_OBJECT_SESSION, s);
                 if (r < 0)
                         return r;
 
@@ -937,7 +1083,7 @@ void session_remove_fifo(Session *s) {
         assert(s);
 
         if (s->fifo_fd >= 0) {
-                assert_se(hashmap_remove(s->manager->session_fds, INT_TO_PTR(s->fifo_fd + 1)) == s);
+                assert_se(manager_remove_fd_object(s->manager, s->fifo_fd) == s);
                 assert_se(epoll_ctl(s->manager->epoll_fd, EPOLL_CTL_DEL, s->fifo_fd, NULL) == 0);
                 close_nointr_nofail(s->fifo_fd);
                 s->fifo_fd = -1;
@@ -992,6 +1138,7 @@ void session_add_to_gc_queue(Session *s) {
 
         LIST_PREPEND(Session, gc_queue, s->manager->session_gc_queue, s);
         s->in_gc_queue = true;
+        s->manager->n_gc_queue++;
 }
 
 SessionState session_get_state(Session *s) {
@@ -61,6 +61,15 @@ typedef enum KillWho {
         _KILL_WHO_INVALID = -1
 } KillWho;
 
+/* What session_start() leaves to the main loop, in this order, after
+ * CreateSession() has been answered */
+typedef enum SessionSetupStage {
+        SESSION_SETUP_CONTROLLERS,
+        SESSION_SETUP_SAVE,
+        SESSION_SETUP_SIGNALS,
+        _SESSION_SETUP_STAGE_MAX
+} SessionSetupStage;
+
 struct Session {
         Manager *manager;
 
@@ -74,14 +83,15 @@ struct Session {
 
         dual_timestamp timestamp;
 
-        char *tty;
-        char *display;
+        /* Interned, see intern.h */
+        const char *tty;
+        const char *display;
 
         bool remote;
-        char *remote_user;
-        char *remote_host;
+        const char *remote_user;
+        const char *remote_host;
 
-        char *service;
+        const char *service;
 
         int vtnr;
         Seat *seat;
@@ -93,19 +103,24 @@ struct Session {
         char *fifo_path;
 
         char *cgroup_path;
-        char **controllers, **reset_controllers;
+        char **controllers, **reset_controllers; /* interned */
 
         bool idle_hint;
         dual_timestamp idle_hint_timestamp;
 
         bool kill_processes;
         bool in_gc_queue:1;
+        bool in_setup_queue:1;
         bool started:1;
 
+        SessionSetupStage setup_stage;
+        usec_t setup_start;
+
         LIST_FIELDS(Session, sessions_by_user);
         LIST_FIELDS(Session, sessions_by_seat);
 
         LIST_FIELDS(Session, gc_queue);
+        LIST_FIELDS(Session, setup_queue);
 };
 
 Session *session_new(Manager *m, User *u, const char *id);
@@ -120,11 +135,14 @@ int session_create_fifo(Session *s);
 void session_remove_fifo(Session *s);
 int session_start(Session *s);
 int session_stop(Session *s);
+bool session_dispatch_setup(Session *s);
 int session_save(Session *s);
 int session_load(Session *s);
+int session_set_string(Session *s, const char **field, const char *value);
 int session_kill(Session *s, KillWho who, int signo);
 
 char *session_bus_path(Session *s);
+int session_append_properties(Session *s, DBusMessageIter *i);
 
 SessionState session_get_state(Session *u);
 
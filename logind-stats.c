@@ -0,0 +1,206 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <string.h>
+
+#include "logind-stats.h"
+
+void stats_init(Stats *s) {
+        assert(s);
+
+        zero(*s);
+        s->since = now(CLOCK_MONOTONIC);
+}
+
+void stats_done(Stats *s) {
+        assert(s);
+
+        hashmap_free_free(s->methods);
+        s->methods = NULL;
+}
+
+void stats_reset(Stats *s) {
+        Histogram *h;
+        Iterator i;
+        unsigned k;
+
+        assert(s);
+
+        for (k = 0; k < _STATS_SOURCE_MAX; k++)
+                histogram_reset(&s->sources[k]);
+
+        /* Keep the method entries, the same methods will be called
+         * again */
+        HASHMAP_FOREACH(h, s->methods, i)
+                histogram_reset(h);
+
+        histogram_reset(&s->unknown_method);
+
+        s->since = now(CLOCK_MONOTONIC);
+}
+
+int stats_record_method(Stats *s, const char *method, usec_t usec) {
+        Histogram *h;
+        int r;
+
+        assert(s);
+
+        if (!method) {
+                histogram_record(&s->unknown_method, usec);
+                return 0;
+        }
+
+        h = hashmap_get(s->methods, method);
+        if (!h) {
+                r = hashmap_ensure_allocated(&s->methods, string_hash_func, string_compare_func);
+                if (r < 0)
+                        return r;
+
+                h = new0(Histogram, 1);
+                if (!h)
+                        return -ENOMEM;
+
+                r = hashmap_put(s->methods, method, h);
+                if (r < 0) {
+                        free(h);
+                        return r;
+                }
+        }
+
+        histogram_record(h, usec);
+        return 0;
+}
+
+static int append_histogram(DBusMessageIter *i, const char *name, const Histogram *h) {
+        DBusMessageIter sub, buckets;
+        uint64_t p50, p99;
+        unsigned b;
+
+        assert(i);
+        assert(name);
+        assert(h);
+
+        p50 = histogram_percentile(h, 500);
+        p99 = histogram_percentile(h, 990);
+
+        if (!dbus_message_iter_open_container(i, DBUS_TYPE_STRUCT, NULL, &sub) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_STRING, &name) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &h->count) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &h->sum) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &h->min) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &h->max) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &p50) ||
+            !dbus_message_iter_append_basic(&sub, DBUS_TYPE_UINT64, &p99) ||
+            !dbus_message_iter_open_container(&sub, DBUS_TYPE_ARRAY, "(tt)", &buckets))
+                return -ENOMEM;
+
+        /* Only the buckets in use, each as its lowest value and count */
+        for (b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                DBusMessageIter bucket;
+                uint64_t lowest;
+
+                if (h->buckets[b] == 0)
+                        continue;
+
+                lowest = histogram_bucket_lowest(b);
+
+                if (!dbus_message_iter_open_container(&buckets, DBUS_TYPE_STRUCT, NULL, &bucket) ||
+                    !dbus_message_iter_append_basic(&bucket, DBUS_TYPE_UINT64, &lowest) ||
+                    !dbus_message_iter_append_basic(&bucket, DBUS_TYPE_UINT64, &h->buckets[b]) ||
+                    !dbus_message_iter_close_container(&buckets, &bucket))
+                        return -ENOMEM;
+        }
+
+        if (!dbus_message_iter_close_container(&sub, &buckets) ||
+            !dbus_message_iter_close_container(i, &sub))
+                return -ENOMEM;
+
+        return 0;
+}
+
+int stats_append(Stats *s, DBusMessageIter *i) {
+        DBusMessageIter sub;
+        const char *name;
+        Histogram *h;
+        Iterator j;
+        uint64_t since;
+        unsigned k;
+        int r;
+
+        assert(s);
+        assert(i);
+
+        since = now(CLOCK_MONOTONIC) - s->since;
+        if (!dbus_message_iter_append_basic(i, DBUS_TYPE_UINT64, &since))
+                return -ENOMEM;
+
+        if (!dbus_message_iter_open_container(i, DBUS_TYPE_ARRAY, "(stttttta(tt))", &sub))
+                return -ENOMEM;
+
+        for (k = 0; k < _STATS_SOURCE_MAX; k++) {
+                r = append_histogram(&sub, stats_source_to_string(k), &s->sources[k]);
+                if (r < 0)
+                        return r;
+        }
+
+        if (!dbus_message_iter_close_container(i, &sub))
+                return -ENOMEM;
+
+        if (!dbus_message_iter_open_container(i, DBUS_TYPE_ARRAY, "(stttttta(tt))", &sub))
+                return -ENOMEM;
+
+        HASHMAP_FOREACH_KEY(h, name, s->methods, j) {
+                r = append_histogram(&sub, name, h);
+                if (r < 0)
+                        return r;
+        }
+
+        r = append_histogram(&sub, "unknown", &s->unknown_method);
+        if (r < 0)
+                return r;
+
+        if (!dbus_message_iter_close_container(i, &sub))
+                return -ENOMEM;
+
+        return 0;
+}
+
+static const char* const stats_source_table[_STATS_SOURCE_MAX] = {
+        [STATS_FD_SEAT_UDEV] = "seat-udev",
+        [STATS_FD_VCSA_UDEV] = "vcsa-udev",
+        [STATS_FD_BUTTON_UDEV] = "button-udev",
+        [STATS_FD_CONSOLE] = "console",
+        [STATS_FD_TIMER] = "timer",
+        [STATS_FD_SESSION] = "session-fifo",
+        [STATS_FD_INHIBITOR] = "inhibitor-fifo",
+        [STATS_FD_BUTTON] = "button",
+        [STATS_FD_BUS] = "bus",
+        [STATS_FD_OTHER] = "other",
+        [STATS_GC] = "gc",
+        [STATS_SAVE] = "save",
+        [STATS_ACL] = "acl",
+        [STATS_SESSION_CONTROLLERS] = "session-controllers",
+        [STATS_SESSION_SAVE] = "session-save",
+        [STATS_SESSION_SIGNALS] = "session-signals",
+        [STATS_SESSION_SETUP] = "session-setup",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(stats_source, StatsSource);
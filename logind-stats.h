@@ -0,0 +1,96 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+typedef struct Stats Stats;
+
+#include <dbus/dbus.h>
+
+#include "util.h"
+#include "hashmap.h"
+#include "histogram.h"
+
+/* Dispatch latencies of the main loop, in microseconds, exported on
+ * the org.freedesktop.login1.Stats interface */
+
+typedef enum StatsSource {
+        STATS_FD_SEAT_UDEV,
+        STATS_FD_VCSA_UDEV,
+        STATS_FD_BUTTON_UDEV,
+        STATS_FD_CONSOLE,
+        STATS_FD_TIMER,
+        STATS_FD_SESSION,
+        STATS_FD_INHIBITOR,
+        STATS_FD_BUTTON,
+        STATS_FD_BUS,
+        STATS_FD_OTHER,
+        STATS_GC,
+        STATS_SAVE,
+        STATS_ACL,
+        STATS_SESSION_CONTROLLERS,
+        STATS_SESSION_SAVE,
+        STATS_SESSION_SIGNALS,
+        STATS_SESSION_SETUP,
+        _STATS_SOURCE_MAX,
+        _STATS_SOURCE_INVALID = -1
+} StatsSource;
+
+struct Stats {
+        Histogram sources[_STATS_SOURCE_MAX];
+
+        /* Method calls, by "interface.member" as in the method
+         * table, and all calls of methods it doesn't know */
+        Hashmap *methods;
+        Histogram unknown_method;
+
+        usec_t since;
+};
+
+void stats_init(Stats *s);
+void stats_done(Stats *s);
+void stats_reset(Stats *s);
+
+static inline void stats_record(Stats *s, StatsSource source, usec_t usec) {
+        histogram_record(&s->sources[source], usec);
+}
+
+/* Records the time passed since start and returns the current time,
+ * so that back-to-back events need only one clock read each */
+static inline usec_t stats_record_since(Stats *s, StatsSource source, usec_t start) {
+        usec_t n;
+
+        n = now(CLOCK_MONOTONIC);
+        stats_record(s, source, n - start);
+
+        return n;
+}
+
+/* Records a call of method, a name from the method table, which is
+ * not copied. Calls of unknown methods, method NULL, share one
+ * histogram, so that clients cannot make us allocate one per name. */
+int stats_record_method(Stats *s, const char *method, usec_t usec);
+
+/* Appends the time since the last reset, and the sources and the
+ * methods as a(stttttta(tt)) each */
+int stats_append(Stats *s, DBusMessageIter *i);
+
+const char *stats_source_to_string(StatsSource s) _const_;
+StatsSource stats_source_from_string(const char *s) _pure_;
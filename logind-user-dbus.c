@@ -25,6 +25,7 @@
 #include "logind.h"
 #include "logind-user.h"
 #include "dbus-common.h"
+#include "logind-method.h"
 
 #define BUS_USER_INTERFACE \
         " <interface name=\"org.freedesktop.login1.User\">\n"           \
@@ -245,6 +246,18 @@ static const BusProperty bus_login_user_properties[] = {
         { NULL, }
 };
 
+int user_append_properties(User *u, DBusMessageIter *i) {
+        const BusBoundProperties bps[] = {
+                { "org.freedesktop.login1.User", bus_login_user_properties, u },
+                { NULL, }
+        };
+
+        assert(u);
+        assert(i);
+
+        return bus_append_properties(i, bps, NULL);
+}
+
 static DBusHandlerResult user_message_dispatch(
                 User *u,
                 DBusConnection *connection,
@@ -258,7 +271,9 @@ static DBusHandlerResult user_message_dispatch(
         assert(connection);
         assert(message);
 
-        if (dbus_message_is_method_call(message, "org.freedesktop.login1.User", "Terminate")) {
+        switch (logind_method_from_message(message, LOGIND_OBJECT_USER)) {
+
+        case USER_METHOD_TERMINATE: {
 
                 r = user_stop(u);
                 if (r < 0)
@@ -267,7 +282,11 @@ static DBusHandlerResult user_message_dispatch(
                 reply = dbus_message_new_method_return(message);
                 if (!reply)
                         goto oom;
-        } else if (dbus_message_is_method_call(message, "org.freedesktop.login1.User", "Kill")) {
+
+                break;
+        }
+
+        case USER_METHOD_KILL: {
                 int32_t signo;
 
                 if (!dbus_message_get_args(
@@ -288,7 +307,10 @@ static DBusHandlerResult user_message_dispatch(
                 if (!reply)
                         goto oom;
 
-        } else {
+                break;
+        }
+
+        default: {
                 const BusBoundProperties bps[] = {
                         { "org.freedesktop.login1.User", bus_login_user_properties, u },
                         { NULL, }
@@ -296,6 +318,7 @@ static DBusHandlerResult user_message_dispatch(
 
                 return bus_default_message_handler(connection, message, INTROSPECTION, INTERFACES_LIST, bps);
         }
+        }
 
         if (reply) {
                 if (!bus_maybe_send_reply(connection, message, reply))
@@ -30,6 +30,9 @@
 #include "hashmap.h"
 #include "strv.h"
 #include "fileio.h"
+#include "mempool.h"
+
+DEFINE_MEMPOOL(user_pool, User, 64);
 
 User* user_new(Manager *m, uid_t uid, gid_t gid, const char *name) {
         User *u;
@@ -37,26 +40,26 @@ User* user_new(Manager *m, uid_t uid, gid_t gid, const char *name) {
         assert(m);
         assert(name);
 
-        u = new0(User, 1);
+        u = mempool_alloc0_tile(&user_pool);
         if (!u)
                 return NULL;
 
         u->name = strdup(name);
         if (!u->name) {
-                free(u);
+                mempool_free_tile(&user_pool, u);
                 return NULL;
         }
 
         if (asprintf(&u->state_file, "/run/systemd/users/%lu", (unsigned long) uid) < 0) {
                 free(u->name);
-                free(u);
+                mempool_free_tile(&user_pool, u);
                 return NULL;
         }
 
         if (hashmap_put(m->users, ULONG_TO_PTR((unsigned long) uid), u) < 0) {
                 free(u->state_file);
                 free(u->name);
-                free(u);
+                mempool_free_tile(&user_pool, u);
                 return NULL;
         }
 
@@ -70,14 +73,16 @@ User* user_new(Manager *m, uid_t uid, gid_t gid, const char *name) {
 void user_free(User *u) {
         assert(u);
 
-        if (u->in_gc_queue)
+        if (u->in_gc_queue) {
                 LIST_REMOVE(User, gc_queue, u->manager->user_gc_queue, u);
+                u->manager->n_gc_queue--;
+        }
 
         while (u->sessions)
                 session_free(u->sessions);
 
         if (u->cgroup_path)
-                hashmap_remove(u->manager->user_cgroups, u->cgroup_path);
+                manager_cgroup_unmap_user(u->manager, u->cgroup_path, u);
         free(u->cgroup_path);
 
         free(u->service);
@@ -87,13 +92,14 @@ void user_free(User *u) {
 
         free(u->name);
         free(u->state_file);
-        free(u);
+        mempool_free_tile(&user_pool, u);
 }
 
 int user_save(User *u) {
         FILE *f;
         int r;
         char *temp_path;
+        usec_t start;
 
         assert(u);
         assert(u->state_file);
@@ -101,6 +107,8 @@ int user_save(User *u) {
         if (!u->started)
                 return 0;
 
+        start = now(CLOCK_MONOTONIC);
+
         r = mkdir_safe_label("/run/systemd/users", 0755, 0, 0);
         if (r < 0)
                 goto finish;
@@ -237,6 +245,8 @@ int user_save(User *u) {
         free(temp_path);
 
 finish:
+        stats_record_since(&u->manager->stats, STATS_SAVE, start);
+
         if (r < 0)
                 log_error("Failed to save user data for %s: %s", u->name, strerror(-r));
 
@@ -342,7 +352,7 @@ static int user_create_cgroup(User *u) {
 
         STRV_FOREACH(k, u->manager->controllers) {
 
-                if (strv_contains(u->manager->reset_controllers, *k))
+                if (intern_strv_contains(u->manager->reset_controllers, *k))
                         continue;
 
                 r = cg_create(*k, p, NULL);
@@ -350,7 +360,7 @@ static int user_create_cgroup(User *u) {
                         log_warning("Failed to create cgroup %s:%s: %s", *k, p, strerror(-r));
         }
 
-        r = hashmap_put(u->manager->user_cgroups, u->cgroup_path, u);
+        r = manager_cgroup_map_user(u->manager, u->cgroup_path, u);
         if (r < 0)
                 log_warning("Failed to create mapping between cgroup and user");
 
@@ -458,7 +468,7 @@ static int user_terminate_cgroup(User *u) {
         STRV_FOREACH(k, u->manager->controllers)
                 cg_trim(*k, u->cgroup_path, true);
 
-        hashmap_remove(u->manager->user_cgroups, u->cgroup_path);
+        manager_cgroup_unmap_user(u->manager, u->cgroup_path, u);
 
         free(u->cgroup_path);
         u->cgroup_path = NULL;
@@ -607,6 +617,7 @@ void user_add_to_gc_queue(User *u) {
 
         LIST_PREPEND(User, gc_queue, u->manager->user_gc_queue, u);
         u->in_gc_queue = true;
+        u->manager->n_gc_queue++;
 }
 
 UserState user_get_state(User *u) {
@@ -74,6 +74,7 @@ int user_load(User *u);
 int user_kill(User *u, int signo);
 
 char *user_bus_path(User *s);
+int user_append_properties(User *u, DBusMessageIter *i);
 
 extern const DBusObjectPathVTable bus_user_vtable;
 
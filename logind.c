@@ -28,7 +28,6 @@
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
 #include <linux/vt.h>
-#include <sys/timerfd.h>
 
 #include <systemd/sd-daemon.h>
 
@@ -38,6 +37,15 @@
 #include "strv.h"
 #include "conf-parser.h"
 #include "mkdir.h"
+#include "mempool.h"
+
+static void manager_idle_action_expired(Timer *t, void *userdata) {
+        manager_dispatch_idle_action(userdata);
+}
+
+static void manager_action_timer_expired(Timer *t, void *userdata) {
+        manager_dispatch_delayed(userdata);
+}
 
 Manager *manager_new(void) {
         Manager *m;
@@ -46,14 +54,23 @@ Manager *manager_new(void) {
         if (!m)
                 return NULL;
 
+        hashmap_randomize_hash_key();
+
         m->console_active_fd = -1;
-        m->bus_fd = -1;
         m->udev_seat_fd = -1;
         m->udev_vcsa_fd = -1;
         m->udev_button_fd = -1;
         m->epoll_fd = -1;
         m->reserve_vt_fd = -1;
 
+        timer_queue_init(&m->timers);
+        stats_init(&m->stats);
+        stall_monitor_init(&m->stall_monitor);
+        polkit_cache_init(&m->polkit_cache, 256, 10 * USEC_PER_SEC);
+        bus_creds_cache_init(&m->creds);
+        timer_init(&m->action_timer, manager_action_timer_expired, m);
+        timer_init(&m->idle_action_timer, manager_idle_action_expired, m);
+
         m->n_autovts = 6;
         m->reserve_vt = 6;
         m->inhibit_delay_max = 5 * USEC_PER_SEC;
@@ -63,7 +80,9 @@ Manager *manager_new(void) {
         m->handle_lid_switch = HANDLE_SUSPEND;
         m->lid_switch_ignore_inhibited = true;
 
-        m->idle_action_fd = -1;
+        m->stall_threshold_usec = USEC_PER_SEC;
+        m->event_budget[EVENT_CLASS_FIFO] = 16;
+        m->event_budget[EVENT_CLASS_UDEV] = 16;
         m->idle_action_usec = 30 * USEC_PER_MINUTE;
         m->idle_action = HANDLE_IGNORE;
         m->idle_action_not_before_usec = now(CLOCK_MONOTONIC);
@@ -75,16 +94,7 @@ Manager *manager_new(void) {
         m->inhibitors = hashmap_new(string_hash_func, string_compare_func);
         m->buttons = hashmap_new(string_hash_func, string_compare_func);
 
-        m->user_cgroups = hashmap_new(string_hash_func, string_compare_func);
-        m->session_cgroups = hashmap_new(string_hash_func, string_compare_func);
-
-        m->session_fds = hashmap_new(trivial_hash_func, trivial_compare_func);
-        m->inhibitor_fds = hashmap_new(trivial_hash_func, trivial_compare_func);
-        m->button_fds = hashmap_new(trivial_hash_func, trivial_compare_func);
-
-        if (!m->devices || !m->seats || !m->sessions || !m->users || !m->inhibitors || !m->buttons ||
-            !m->user_cgroups || !m->session_cgroups ||
-            !m->session_fds || !m->inhibitor_fds || !m->button_fds) {
+        if (!m->devices || !m->seats || !m->sessions || !m->users || !m->inhibitors || !m->buttons) {
                 manager_free(m);
                 return NULL;
         }
@@ -117,9 +127,12 @@ void manager_free(Manager *m) {
         Seat *s;
         Inhibitor *i;
         Button *b;
+        BusCall *call;
 
         assert(m);
 
+        stall_monitor_stop(&m->stall_monitor);
+
         while ((session = hashmap_first(m->sessions)))
                 session_free(session);
 
@@ -145,12 +158,7 @@ void manager_free(Manager *m) {
         hashmap_free(m->inhibitors);
         hashmap_free(m->buttons);
 
-        hashmap_free(m->user_cgroups);
-        hashmap_free(m->session_cgroups);
-
-        hashmap_free(m->session_fds);
-        hashmap_free(m->inhibitor_fds);
-        hashmap_free(m->button_fds);
+        cgroup_node_free(m->cgroup_root);
 
         if (m->console_active_fd >= 0)
                 close_nointr_nofail(m->console_active_fd);
@@ -165,14 +173,29 @@ void manager_free(Manager *m) {
         if (m->udev)
                 udev_unref(m->udev);
 
+        bus_call_cancel(m->action_call);
+        if (m->action_request)
+                dbus_message_unref(m->action_request);
+
+        while ((call = hashmap_steal_first(m->autovt_calls)))
+                bus_call_cancel(call);
+        hashmap_free(m->autovt_calls);
+
+        polkit_registry_free(m->polkit_registry);
+        polkit_cache_done(&m->polkit_cache);
+        bus_creds_cache_done(&m->creds);
+
         if (m->bus) {
                 dbus_connection_flush(m->bus);
+                bus_loop_close(m->bus);
                 dbus_connection_close(m->bus);
                 dbus_connection_unref(m->bus);
         }
 
-        if (m->bus_fd >= 0)
-                close_nointr_nofail(m->bus_fd);
+        free(m->fd_objects);
+
+        timer_queue_done(&m->timers);
+        stats_done(&m->stats);
 
         if (m->epoll_fd >= 0)
                 close_nointr_nofail(m->epoll_fd);
@@ -180,11 +203,16 @@ void manager_free(Manager *m) {
         if (m->reserve_vt_fd >= 0)
                 close_nointr_nofail(m->reserve_vt_fd);
 
-        if (m->idle_action_fd >= 0)
-                close_nointr_nofail(m->idle_action_fd);
+        if (m->controllers_interned) {
+                intern_strv_unref(&m->interned, m->controllers);
+                intern_strv_unref(&m->interned, m->reset_controllers);
+        } else {
+                strv_free(m->controllers);
+                strv_free(m->reset_controllers);
+        }
+
+        intern_table_done(&m->interned);
 
-        strv_free(m->controllers);
-        strv_free(m->reset_controllers);
         strv_free(m->kill_only_users);
         strv_free(m->kill_exclude_users);
 
@@ -966,10 +994,29 @@ static int vt_is_busy(int vtnr) {
         return r;
 }
 
+static void manager_spawn_autovt_done(BusCall *call, int r, DBusMessage *reply, DBusError *error, void *userdata) {
+        Manager *m = userdata;
+        BusCall *c;
+        Iterator i;
+        const void *k;
+
+        assert(m);
+
+        HASHMAP_FOREACH_KEY(c, k, m->autovt_calls, i)
+                if (c == call) {
+                        hashmap_remove(m->autovt_calls, k);
+
+                        if (r < 0)
+                                log_error("Failed to start autovt on tty%i: %s", PTR_TO_INT(k), bus_error(error, r));
+                        break;
+                }
+}
+
 int manager_spawn_autovt(Manager *m, int vtnr) {
         int r;
         char *name = NULL;
         const char *mode = "fail";
+        BusCall *call;
 
         assert(m);
         assert(vtnr >= 1);
@@ -978,6 +1025,11 @@ int manager_spawn_autovt(Manager *m, int vtnr) {
             (unsigned) vtnr != m->reserve_vt)
                 return 0;
 
+        /* Switching back and forth quickly shouldn't pile up start
+         * requests for the same getty */
+        if (hashmap_get(m->autovt_calls, INT_TO_PTR(vtnr)))
+                return 0;
+
         if ((unsigned) vtnr != m->reserve_vt) {
                 /* If this is the reserved TTY, we'll start the getty
                  * on it in any case, but otherwise only if it is not
@@ -996,17 +1048,31 @@ int manager_spawn_autovt(Manager *m, int vtnr) {
                 goto finish;
         }
 
-        r = bus_method_call_with_reply (
+        r = hashmap_ensure_allocated(&m->autovt_calls, trivial_hash_func, trivial_compare_func);
+        if (r < 0)
+                goto finish;
+
+        r = bus_call_async(
                         m->bus,
+                        0,
+                        manager_spawn_autovt_done,
+                        m,
+                        &call,
                         "org.freedesktop.systemd1",
                         "/org/freedesktop/systemd1",
                         "org.freedesktop.systemd1.Manager",
                         "StartUnit",
-                        NULL,
-                        NULL,
                         DBUS_TYPE_STRING, &name,
                         DBUS_TYPE_STRING, &mode,
                         DBUS_TYPE_INVALID);
+        if (r < 0) {
+                log_error("Failed to start %s: %s", name, strerror(-r));
+                goto finish;
+        }
+
+        r = hashmap_put(m->autovt_calls, INT_TO_PTR(vtnr), call);
+        if (r < 0)
+                bus_call_cancel(call);
 
 finish:
         free(name);
@@ -1038,75 +1104,23 @@ static int manager_reserve_vt(Manager *m) {
 }
 
 int manager_get_session_by_cgroup(Manager *m, const char *cgroup, Session **session) {
-        Session *s;
-        char *p;
-
         assert(m);
         assert(cgroup);
         assert(session);
 
-        s = hashmap_get(m->session_cgroups, cgroup);
-        if (s) {
-                *session = s;
-                return 1;
-        }
-
-        p = strdupa(cgroup);
-
-        for (;;) {
-                char *e;
+        manager_cgroup_lookup(m, cgroup, session, NULL);
 
-                e = strrchr(p, '/');
-                if (!e || e == p) {
-                        *session = NULL;
-                        return 0;
-                }
-
-                *e = 0;
-
-                s = hashmap_get(m->session_cgroups, p);
-                if (s) {
-                        *session = s;
-                        return 1;
-                }
-        }
+        return !!*session;
 }
 
 int manager_get_user_by_cgroup(Manager *m, const char *cgroup, User **user) {
-        User *u;
-        char *p;
-
         assert(m);
         assert(cgroup);
         assert(user);
 
-        u = hashmap_get(m->user_cgroups, cgroup);
-        if (u) {
-                *user = u;
-                return 1;
-        }
-
-        p = strdupa(cgroup);
-        if (!p)
-                return log_oom();
-
-        for (;;) {
-                char *e;
+        manager_cgroup_lookup(m, cgroup, NULL, user);
 
-                e = strrchr(p, '/');
-                if (!e || e == p) {
-                        *user = NULL;
-                        return 0;
-                }
-
-                *e = 0;
-
-                u = hashmap_get(m->user_cgroups, p);
-                if (u) {
-                        *user = u;
-                        return 1;
-                }
-        }
+        return !!*user;
 }
 
 int manager_get_session_by_pid(Manager *m, pid_t pid, Session **session) {
@@ -1127,18 +1141,18 @@ int manager_get_session_by_pid(Manager *m, pid_t pid, Session **session) {
 void manager_cgroup_notify_empty(Manager *m, const char *cgroup) {
         Session *s;
         User *u;
-        int r;
 
-        r = manager_get_session_by_cgroup(m, cgroup, &s);
-        if (r > 0)
+        manager_cgroup_lookup(m, cgroup, &s, &u);
+
+        if (s)
                 session_add_to_gc_queue(s);
 
-        r = manager_get_user_by_cgroup(m, cgroup, &u);
-        if (r > 0)
+        if (u)
                 user_add_to_gc_queue(u);
 }
 
-static void manager_dispatch_other(Manager *m, int fd) {
+static void manager_dispatch_other(Manager *m, int fd, uint32_t events) {
+        FdObject *o;
         Session *s;
         Inhibitor *i;
         Button *b;
@@ -1146,43 +1160,99 @@ static void manager_dispatch_other(Manager *m, int fd) {
         assert_se(m);
         assert_se(fd >= 0);
 
-        s = hashmap_get(m->session_fds, INT_TO_PTR(fd + 1));
-        if (s) {
+        o = manager_get_fd_object(m, fd);
+        if (!o)
+                return;
+
+        switch (o->type) {
+
+        case FD_OBJECT_SESSION:
+                s = o->object;
                 assert(s->fifo_fd == fd);
                 session_remove_fifo(s);
                 session_stop(s);
-                return;
-        }
+                break;
 
-        i = hashmap_get(m->inhibitor_fds, INT_TO_PTR(fd + 1));
-        if (i) {
+        case FD_OBJECT_INHIBITOR:
+                i = o->object;
                 assert(i->fifo_fd == fd);
                 inhibitor_stop(i);
                 inhibitor_free(i);
-                return;
-        }
+                break;
 
-        b = hashmap_get(m->button_fds, INT_TO_PTR(fd + 1));
-        if (b) {
+        case FD_OBJECT_BUTTON:
+                b = o->object;
                 assert(b->fd == fd);
                 button_process(b);
-                return;
+                break;
+
+        case FD_OBJECT_BUS:
+                bus_loop_dispatch(o->object, events);
+                break;
+
+        default:
+                assert_not_reached("Got event for unknown fd");
+        }
+}
+
+static int manager_bus_add_fd(void *userdata, int fd, uint32_t events, void *object) {
+        Manager *m = userdata;
+        struct epoll_event ev = {
+                .events = events,
+                .data.u32 = FD_OTHER_BASE + fd,
+        };
+        int r;
+
+        assert(m);
+
+        r = manager_add_fd_object(m, fd, FD_OBJECT_BUS, object);
+        if (r < 0)
+                return r;
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                manager_remove_fd_object(m, fd);
+                return -errno;
         }
 
-        assert_not_reached("Got event for unknown fd");
+        return 0;
+}
+
+static int manager_bus_modify_fd(void *userdata, int fd, uint32_t events) {
+        Manager *m = userdata;
+        struct epoll_event ev = {
+                .events = events,
+                .data.u32 = FD_OTHER_BASE + fd,
+        };
+
+        assert(m);
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0)
+                return -errno;
+
+        return 0;
 }
 
+static void manager_bus_remove_fd(void *userdata, int fd) {
+        Manager *m = userdata;
+
+        assert(m);
+
+        assert_se(epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, fd, NULL) >= 0);
+        manager_remove_fd_object(m, fd);
+}
+
+static const BusLoopOps manager_bus_loop_ops = {
+        .add_fd = manager_bus_add_fd,
+        .modify_fd = manager_bus_modify_fd,
+        .remove_fd = manager_bus_remove_fd,
+};
+
 static int manager_connect_bus(Manager *m) {
         DBusError error;
         int r;
-        struct epoll_event ev = {
-                .events = EPOLLIN,
-                .data.u32 = FD_BUS,
-        };
 
         assert(m);
         assert(!m->bus);
-        assert(m->bus_fd < 0);
 
         dbus_error_init(&error);
 
@@ -1215,6 +1285,31 @@ static int manager_connect_bus(Manager *m) {
                 goto fail;
         }
 
+        /* Drop cached authorizations when polkit changes its mind,
+         * and cached credentials and authorizations when a peer goes
+         * away. Only ask for names losing their owner, we'd be woken
+         * up for every client connecting to the bus otherwise. */
+        dbus_bus_add_match(m->bus,
+                           "type='signal',"
+                           "sender='org.freedesktop.PolicyKit1',"
+                           "interface='org.freedesktop.PolicyKit1.Authority',"
+                           "member='Changed'",
+                           &error);
+        if (!dbus_error_is_set(&error))
+                dbus_bus_add_match(m->bus,
+                                   "type='signal',"
+                                   "sender='"DBUS_SERVICE_DBUS"',"
+                                   "interface='"DBUS_INTERFACE_DBUS"',"
+                                   "member='NameOwnerChanged',"
+                                   "arg2=''",
+                                   &error);
+
+        if (dbus_error_is_set(&error)) {
+                log_error("Failed to register match: %s", bus_error_message(&error));
+                r = -EIO;
+                goto fail;
+        }
+
         r = dbus_bus_request_name(m->bus, "org.freedesktop.login1", DBUS_NAME_FLAG_DO_NOT_QUEUE, &error);
         if (dbus_error_is_set(&error)) {
                 log_error("Failed to register name on bus: %s", bus_error_message(&error));
@@ -1228,13 +1323,10 @@ static int manager_connect_bus(Manager *m) {
                 goto fail;
         }
 
-        m->bus_fd = bus_loop_open(m->bus);
-        if (m->bus_fd < 0) {
-                r = m->bus_fd;
-                goto fail;
-        }
-
-        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->bus_fd, &ev) < 0)
+        /* Bus watches and timeouts go straight into our own epoll,
+         * so that one epoll_wait() covers everything */
+        r = bus_loop_open(m->bus, &manager_bus_loop_ops, &m->timers, m);
+        if (r < 0)
                 goto fail;
 
         return 0;
@@ -1245,6 +1337,27 @@ fail:
         return r;
 }
 
+static int manager_connect_timers(Manager *m) {
+        struct epoll_event ev = {
+                .events = EPOLLIN,
+                .data.u32 = FD_TIMER,
+        };
+        int fd;
+
+        assert(m);
+
+        fd = timer_queue_open(&m->timers);
+        if (fd < 0) {
+                log_error("Failed to create timer: %s", strerror(-fd));
+                return fd;
+        }
+
+        if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                return -errno;
+
+        return 0;
+}
+
 static int manager_connect_console(Manager *m) {
         struct epoll_event ev = {
                 .events = 0,
@@ -1367,16 +1480,38 @@ static int manager_connect_udev(Manager *m) {
         return 0;
 }
 
-void manager_gc(Manager *m, bool drop_not_started) {
+static bool manager_gc_slice_done(usec_t end, unsigned n) {
+        if (n <= 0)
+                return false;
+
+        return n >= MANAGER_GC_SLICE_MAX || now(CLOCK_MONOTONIC) >= end;
+}
+
+/* With sliced set, stops once the slice budget is used up and leaves
+ * the rest queued for the next main loop iteration. Returns > 0 if
+ * objects are left in the queues. */
+int manager_gc(Manager *m, bool drop_not_started, bool sliced) {
         Seat *seat;
         Session *session;
         User *user;
+        usec_t start, elapsed;
+        unsigned n = 0;
 
         assert(m);
 
+        if (!m->seat_gc_queue && !m->session_gc_queue && !m->user_gc_queue)
+                return 0;
+
+        start = now(CLOCK_MONOTONIC);
+        stall_monitor_enter(&m->stall_monitor, "gc", start);
+
         while ((seat = m->seat_gc_queue)) {
+                if (sliced && manager_gc_slice_done(start + MANAGER_GC_SLICE_USEC, n++))
+                        goto finish;
+
                 LIST_REMOVE(Seat, gc_queue, m->seat_gc_queue, seat);
                 seat->in_gc_queue = false;
+                m->n_gc_queue--;
 
                 if (seat_check_gc(seat, drop_not_started) == 0) {
                         seat_stop(seat);
@@ -1385,8 +1520,12 @@ void manager_gc(Manager *m, bool drop_not_started) {
         }
 
         while ((session = m->session_gc_queue)) {
+                if (sliced && manager_gc_slice_done(start + MANAGER_GC_SLICE_USEC, n++))
+                        goto finish;
+
                 LIST_REMOVE(Session, gc_queue, m->session_gc_queue, session);
                 session->in_gc_queue = false;
+                m->n_gc_queue--;
 
                 if (session_check_gc(session, drop_not_started) == 0) {
                         session_stop(session);
@@ -1395,14 +1534,60 @@ void manager_gc(Manager *m, bool drop_not_started) {
         }
 
         while ((user = m->user_gc_queue)) {
+                if (sliced && manager_gc_slice_done(start + MANAGER_GC_SLICE_USEC, n++))
+                        goto finish;
+
                 LIST_REMOVE(User, gc_queue, m->user_gc_queue, user);
                 user->in_gc_queue = false;
+                m->n_gc_queue--;
 
                 if (user_check_gc(user, drop_not_started) == 0) {
                         user_stop(user);
                         user_free(user);
                 }
         }
+
+finish:
+        elapsed = now(CLOCK_MONOTONIC) - start;
+        m->gc_usec += elapsed;
+        stats_record(&m->stats, STATS_GC, elapsed);
+        stall_monitor_leave(&m->stall_monitor, start + elapsed);
+
+        return m->seat_gc_queue || m->session_gc_queue || m->user_gc_queue;
+}
+
+unsigned manager_gc_queue_length(Manager *m) {
+        assert(m);
+
+        return m->n_gc_queue;
+}
+
+/* Completes the setup of started sessions a stage at a time, in the
+ * order they were started in, and only for a slice of time. Returns
+ * > 0 if sessions are left in the queue. */
+int manager_dispatch_session_setup(Manager *m) {
+        Session *session;
+        usec_t start;
+        unsigned n = 0;
+
+        assert(m);
+
+        if (!m->session_setup_queue)
+                return 0;
+
+        start = now(CLOCK_MONOTONIC);
+        stall_monitor_enter(&m->stall_monitor, "session-setup", start);
+
+        while ((session = m->session_setup_queue)) {
+                if (manager_gc_slice_done(start + MANAGER_GC_SLICE_USEC, n++))
+                        break;
+
+                session_dispatch_setup(session);
+        }
+
+        stall_monitor_leave(&m->stall_monitor, now(CLOCK_MONOTONIC));
+
+        return !!m->session_setup_queue;
 }
 
 int manager_get_idle_hint(Manager *m, dual_timestamp *t) {
@@ -1446,24 +1631,23 @@ int manager_get_idle_hint(Manager *m, dual_timestamp *t) {
 
 int manager_dispatch_idle_action(Manager *m) {
         struct dual_timestamp since;
-        struct itimerspec its = {};
+        usec_t n, deadline;
         int r;
-        usec_t n;
 
         assert(m);
 
         if (m->idle_action == HANDLE_IGNORE ||
             m->idle_action_usec <= 0) {
-                r = 0;
-                goto finish;
+                timer_stop(&m->timers, &m->idle_action_timer);
+                return 0;
         }
 
-        n = now(CLOCK_MONOTONIC);
+        n = timer_queue_now(&m->timers);
 
         r = manager_get_idle_hint(m, &since);
         if (r <= 0)
                 /* Not idle. Let's check if after a timeout it might be idle then. */
-                timespec_store(&its.it_value, n + m->idle_action_usec);
+                deadline = n + m->idle_action_usec;
         else {
                 /* Idle! Let's see if it's time to do something, or if
                  * we shall sleep for longer. */
@@ -1476,45 +1660,48 @@ int manager_dispatch_idle_action(Manager *m) {
                         m->idle_action_not_before_usec = n;
                 }
 
-                timespec_store(&its.it_value, MAX(since.monotonic, m->idle_action_not_before_usec) + m->idle_action_usec);
+                deadline = MAX(since.monotonic, m->idle_action_not_before_usec) + m->idle_action_usec;
         }
 
-        if (m->idle_action_fd < 0) {
-                struct epoll_event ev = {
-                        .events = EPOLLIN,
-                        .data.u32 = FD_IDLE_ACTION,
-                };
+        /* Idleness is counted in minutes, a second late is fine */
+        r = timer_start(&m->timers, &m->idle_action_timer, deadline, USEC_PER_SEC);
+        if (r < 0) {
+                log_error("Failed to schedule idle action: %s", strerror(-r));
+                return r;
+        }
 
-                m->idle_action_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
-                if (m->idle_action_fd < 0) {
-                        log_error("Failed to create idle action timer: %m");
-                        r = -errno;
-                        goto finish;
-                }
+        return 0;
+}
 
-                if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->idle_action_fd, &ev) < 0) {
-                        log_error("Failed to add idle action timer to epoll: %m");
-                        r = -errno;
-                        goto finish;
-                }
-        }
+/* Sessions intern their controller lists in the same table, so that
+ * they can be compared against ours by pointer */
+static int manager_intern_controllers(Manager *m) {
+        char **c, **rc;
+        int r;
 
-        if (timerfd_settime(m->idle_action_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
-                log_error("Failed to reset timerfd: %m");
-                r = -errno;
-                goto finish;
-        }
+        assert(m);
+        assert(!m->controllers_interned);
 
-        return 0;
+        r = intern_strv(&m->interned, m->controllers, &c);
+        if (r < 0)
+                return r;
 
-finish:
-        if (m->idle_action_fd >= 0) {
-                close_nointr_nofail(m->idle_action_fd);
-                m->idle_action_fd = -1;
+        r = intern_strv(&m->interned, m->reset_controllers, &rc);
+        if (r < 0) {
+                intern_strv_unref(&m->interned, c);
+                return r;
         }
 
-        return r;
+        strv_free(m->controllers);
+        strv_free(m->reset_controllers);
+
+        m->controllers = c;
+        m->reset_controllers = rc;
+        m->controllers_interned = true;
+
+        return 0;
 }
+
 int manager_startup(Manager *m) {
         int r;
         Seat *seat;
@@ -1529,10 +1716,18 @@ int manager_startup(Manager *m) {
         cg_shorten_controllers(m->reset_controllers);
         cg_shorten_controllers(m->controllers);
 
+        r = manager_intern_controllers(m);
+        if (r < 0)
+                return r;
+
         m->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
         if (m->epoll_fd < 0)
                 return -errno;
 
+        r = manager_connect_timers(m);
+        if (r < 0)
+                return r;
+
         /* Connect to console */
         r = manager_connect_console(m);
         if (r < 0)
@@ -1562,7 +1757,7 @@ int manager_startup(Manager *m) {
         manager_enumerate_buttons(m);
 
         /* Remove stale objects before we start them */
-        manager_gc(m, false);
+        manager_gc(m, false, false);
 
         /* Reserve the special reserved VT */
         manager_reserve_vt(m);
@@ -1582,6 +1777,10 @@ int manager_startup(Manager *m) {
 
         manager_dispatch_idle_action(m);
 
+        r = stall_monitor_start(&m->stall_monitor, m->stall_threshold_usec, m->stall_backtrace);
+        if (r < 0)
+                log_warning("Failed to start stall monitor: %s", strerror(-r));
+
         return 0;
 }
 
@@ -1605,15 +1804,71 @@ static int manager_recheck_buttons(Manager *m) {
         return r;
 }
 
+static void manager_trim_pools(Manager *m) {
+        size_t released, in_use, retained;
+
+        assert(m);
+
+        released = mempool_trim_all();
+        if (released == 0)
+                return;
+
+        mempool_get_stats(&in_use, &retained);
+        log_debug("Released %zu bytes of pool memory, %zu bytes in use, %zu bytes retained.",
+                  released, in_use, retained);
+}
+
+/* Dispatches one epoll event, returns when it was done */
+static usec_t manager_dispatch_event(Manager *m, struct epoll_event *ev, StatsSource source, usec_t start) {
+        usec_t end;
+
+        stall_monitor_enter(&m->stall_monitor, stats_source_to_string(source), start);
+
+        switch (ev->data.u32) {
+
+        case FD_SEAT_UDEV:
+                manager_dispatch_seat_udev(m);
+                break;
+
+        case FD_VCSA_UDEV:
+                manager_dispatch_vcsa_udev(m);
+                break;
+
+        case FD_BUTTON_UDEV:
+                manager_dispatch_button_udev(m);
+                break;
+
+        case FD_CONSOLE:
+                manager_dispatch_console(m);
+                break;
+
+        case FD_TIMER:
+                timer_queue_dispatch(&m->timers);
+                break;
+
+        default:
+                if (ev->data.u32 >= FD_OTHER_BASE)
+                        manager_dispatch_other(m, ev->data.u32 - FD_OTHER_BASE, ev->events);
+        }
+
+        end = stats_record_since(&m->stats, source, start);
+        stall_monitor_leave(&m->stall_monitor, end);
+
+        return end;
+}
+
 int manager_run(Manager *m) {
         assert(m);
 
         for (;;) {
-                struct epoll_event event;
-                int n;
-                int msec = -1;
-
-                manager_gc(m, true);
+                struct epoll_event events[MANAGER_EVENTS_MAX];
+                StatsSource sources[MANAGER_EVENTS_MAX];
+                EventClass classes[MANAGER_EVENTS_MAX];
+                unsigned order[MANAGER_EVENTS_MAX], class_end[_EVENT_CLASS_MAX];
+                unsigned k, n_order;
+                int n, r;
+                bool gc_pending, setup_pending;
+                usec_t start;
 
                 if (manager_dispatch_delayed(m) > 0)
                         continue;
@@ -1624,18 +1879,28 @@ int manager_run(Manager *m) {
                 if (dbus_connection_dispatch(m->bus) != DBUS_DISPATCH_COMPLETE)
                         continue;
 
-                manager_gc(m, true);
+                /* Finish setting up new sessions once their
+                 * CreateSession() calls have been answered */
+                setup_pending = manager_dispatch_session_setup(m) > 0;
 
-                if (m->action_what != 0 && !m->action_job) {
-                        usec_t x, y;
+                /* Collect garbage only once all pending requests
+                 * have been handled, and only a slice of it at a
+                 * time, so that a mass logout doesn't stall the bus */
+                gc_pending = manager_gc(m, true, true) > 0;
 
-                        x = now(CLOCK_MONOTONIC);
-                        y = m->action_timestamp + m->inhibit_delay_max;
+                /* About to go idle, hand back what the last burst of
+                 * sessions left behind */
+                if (!gc_pending && !setup_pending)
+                        manager_trim_pools(m);
 
-                        msec = x >= y ? 0 : (int) ((y - x) / USEC_PER_MSEC);
+                /* Only wake up when a timer is actually due */
+                r = timer_queue_arm(&m->timers);
+                if (r < 0) {
+                        log_error("Failed to arm timer: %s", strerror(-r));
+                        return r;
                 }
 
-                n = epoll_wait(m->epoll_fd, &event, 1, msec);
+                n = epoll_wait(m->epoll_fd, events, ELEMENTSOF(events), gc_pending || setup_pending ? 0 : -1);
                 if (n < 0) {
                         if (errno == EINTR || errno == EAGAIN)
                                 continue;
@@ -1644,38 +1909,44 @@ int manager_run(Manager *m) {
                         return -errno;
                 }
 
+                timer_queue_update_now(&m->timers);
+
                 if (n == 0)
                         continue;
 
-                switch (event.data.u32) {
-
-                case FD_SEAT_UDEV:
-                        manager_dispatch_seat_udev(m);
-                        break;
+                m->n_wakeups++;
+                m->n_events += n;
 
-                case FD_VCSA_UDEV:
-                        manager_dispatch_vcsa_udev(m);
-                        break;
+                /* Classify the batch before dispatching any of it
+                 * closes fds */
+                for (k = 0; k < (unsigned) n; k++) {
+                        sources[k] = manager_event_stats_source(m, events[k].data.u32);
+                        classes[k] = event_class_from_stats_source(sources[k]);
+                }
 
-                case FD_BUTTON_UDEV:
-                        manager_dispatch_button_udev(m);
-                        break;
+                /* Dispatch the batch class by class, and each class
+                 * only up to its budget. All our fds are level
+                 * triggered, what is left over is reported again by
+                 * the next epoll_wait(), which won't block then. As
+                 * every class gets its budget on every wakeup, none
+                 * of them can be starved. */
+                n_order = event_batch_order(classes, n, m->event_budget, order, class_end);
 
-                case FD_CONSOLE:
-                        manager_dispatch_console(m);
-                        break;
+                /* Each event is timed from the end of the previous
+                 * one, the first from when epoll_wait() returned */
+                start = timer_queue_now(&m->timers);
 
-                case FD_IDLE_ACTION:
-                        manager_dispatch_idle_action(m);
-                        break;
+                for (k = 0; k < n_order; k++) {
+                        start = manager_dispatch_event(m, events + order[k], sources[order[k]], start);
 
-                case FD_BUS:
-                        bus_loop_dispatch(m->bus_fd);
-                        break;
+                        /* Answer the method calls we just read,
+                         * before anything of lower priority */
+                        if (k + 1 == class_end[EVENT_CLASS_BUS]) {
+                                while (dbus_connection_dispatch(m->bus) == DBUS_DISPATCH_DATA_REMAINS)
+                                        ;
 
-                default:
-                        if (event.data.u32 >= FD_OTHER_BASE)
-                                manager_dispatch_other(m, event.data.u32 - FD_OTHER_BASE);
+                                start = now(CLOCK_MONOTONIC);
+                        }
                 }
         }
 
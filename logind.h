@@ -31,9 +31,43 @@
 #include "list.h"
 #include "hashmap.h"
 #include "cgroup-util.h"
+#include "intern.h"
+#include "timer-queue.h"
+#include "logind-stats.h"
+#include "stall-monitor.h"
+#include "polkit.h"
+#include "dbus-call.h"
 
 typedef struct Manager Manager;
 
+/* What a FIFO or input device fd watched by the manager belongs to */
+typedef enum FdObjectType {
+        FD_OBJECT_NONE,
+        FD_OBJECT_SESSION,
+        FD_OBJECT_INHIBITOR,
+        FD_OBJECT_BUTTON,
+        FD_OBJECT_BUS
+} FdObjectType;
+
+typedef struct FdObject {
+        FdObjectType type;
+        void *object;
+
+        /* Wakeup of the main loop during which this was registered */
+        uint64_t wakeup;
+} FdObject;
+
+/* Priority classes of epoll events, highest first. The console and
+ * power buttons are cheap and a user is waiting for them, they go
+ * with the timers. */
+typedef enum EventClass {
+        EVENT_CLASS_BUS,
+        EVENT_CLASS_TIMER,
+        EVENT_CLASS_FIFO,
+        EVENT_CLASS_UDEV,
+        _EVENT_CLASS_MAX
+} EventClass;
+
 #include "logind-device.h"
 #include "logind-seat.h"
 #include "logind-session.h"
@@ -41,6 +75,7 @@ typedef struct Manager Manager;
 #include "logind-inhibit.h"
 #include "logind-button.h"
 #include "logind-action.h"
+#include "logind-cgroup.h"
 
 struct Manager {
         DBusConnection *bus;
@@ -52,9 +87,22 @@ struct Manager {
         Hashmap *inhibitors;
         Hashmap *buttons;
 
+        /* Requests waiting for polkit, by message */
+        Hashmap *polkit_registry;
+        PolkitCache polkit_cache;
+
+        /* Credentials of bus peers that talked to us */
+        BusCredsCache creds;
+
         LIST_HEAD(Seat, seat_gc_queue);
         LIST_HEAD(Session, session_gc_queue);
         LIST_HEAD(User, user_gc_queue);
+        unsigned n_gc_queue;
+
+        /* Started sessions whose setup isn't complete yet, oldest
+         * first */
+        LIST_HEAD(Session, session_setup_queue);
+        Session *session_setup_queue_tail;
 
         struct udev *udev;
         struct udev_monitor *udev_seat_monitor, *udev_vcsa_monitor, *udev_button_monitor;
@@ -64,9 +112,11 @@ struct Manager {
         int udev_button_fd;
 
         int console_active_fd;
-        int bus_fd;
         int epoll_fd;
 
+        /* All timers of the daemon, on a single timerfd */
+        TimerQueue timers;
+
         unsigned n_autovts;
 
         unsigned reserve_vt;
@@ -76,6 +126,10 @@ struct Manager {
 
         char *cgroup_path;
         char **controllers, **reset_controllers;
+        bool controllers_interned;
+
+        /* Shared session metadata and controller lists */
+        InternTable interned;
 
         char **kill_only_users, **kill_exclude_users;
 
@@ -84,12 +138,31 @@ struct Manager {
         unsigned long session_counter;
         unsigned long inhibit_counter;
 
-        Hashmap *session_cgroups;
-        Hashmap *user_cgroups;
+        /* Inhibitors with an open FIFO, by mode and what */
+        InhibitorList inhibitor_index[_INHIBIT_MODE_MAX][INHIBIT_WHAT_BITS];
+
+        CGroupNode *cgroup_root;
+
+        /* Indexed by fd, for dispatching FD_OTHER_BASE events */
+        FdObject *fd_objects;
+        unsigned n_fd_objects;
+
+        /* Main loop wakeups and the events dispatched in them */
+        uint64_t n_wakeups;
+        uint64_t n_events;
 
-        Hashmap *session_fds;
-        Hashmap *inhibitor_fds;
-        Hashmap *button_fds;
+        /* Time spent collecting garbage */
+        usec_t gc_usec;
+
+        Stats stats;
+
+        StallMonitor stall_monitor;
+        usec_t stall_threshold_usec;
+        bool stall_backtrace;
+
+        /* Most events of each class dispatched per wakeup, 0 for
+         * no limit */
+        unsigned event_budget[_EVENT_CLASS_MAX];
 
         usec_t inhibit_delay_max;
 
@@ -107,7 +180,17 @@ struct Manager {
         char *action_job;
         usec_t action_timestamp;
 
-        int idle_action_fd; /* the timer_fd */
+        /* While systemd hasn't queued the job yet, the StartUnit()
+         * call, and the request to answer once it has */
+        BusCall *action_call;
+        DBusMessage *action_request;
+
+        /* autovt starts in flight, by VT number */
+        Hashmap *autovt_calls;
+
+        Timer action_timer;
+
+        Timer idle_action_timer;
         usec_t idle_action_usec;
         usec_t idle_action_not_before_usec;
         HandleAction idle_action;
@@ -123,13 +206,20 @@ struct Manager {
         bool lid_switch_ignore_inhibited;
 };
 
+/* Most events dispatched per main loop wakeup */
+#define MANAGER_EVENTS_MAX 64
+
+/* Upper bounds for one slice of garbage collection, checking a
+ * session may involve a walk of its cgroup tree */
+#define MANAGER_GC_SLICE_USEC (5 * USEC_PER_MSEC)
+#define MANAGER_GC_SLICE_MAX 64
+
 enum {
         FD_SEAT_UDEV,
         FD_VCSA_UDEV,
         FD_BUTTON_UDEV,
         FD_CONSOLE,
-        FD_BUS,
-        FD_IDLE_ACTION,
+        FD_TIMER,
         FD_OTHER_BASE
 };
 
@@ -145,6 +235,29 @@ int manager_add_user_by_name(Manager *m, const char *name, User **_user);
 int manager_add_user_by_uid(Manager *m, uid_t uid, User **_user);
 int manager_add_inhibitor(Manager *m, const char* id, Inhibitor **_inhibitor);
 
+int manager_add_fd_object(Manager *m, int fd, FdObjectType type, void *object);
+void *manager_remove_fd_object(Manager *m, int fd);
+
+/* Returns the object an FD_OTHER_BASE event of the current batch is
+ * about, or NULL if its fd was closed or reused meanwhile */
+FdObject *manager_get_fd_object(Manager *m, int fd);
+StatsSource manager_event_stats_source(Manager *m, uint32_t u);
+
+EventClass event_class_from_stats_source(StatsSource s) _pure_;
+
+/* Orders the events of one wakeup for dispatch: class by class,
+ * highest first, in epoll order within a class, and at most budget[c]
+ * events of class c, 0 for no limit. Fills order with indexes into the
+ * batch, and class_end[c] with the position in order just past the
+ * last event of class c, or 0 if there is none. Returns the number of
+ * events to dispatch now, the others are left for the next wakeup. */
+unsigned event_batch_order(
+                const EventClass *classes,
+                unsigned n,
+                const unsigned budget[_EVENT_CLASS_MAX],
+                unsigned *order,
+                unsigned class_end[_EVENT_CLASS_MAX]);
+
 int manager_process_seat_device(Manager *m, struct udev_device *d);
 int manager_process_button_device(Manager *m, struct udev_device *d);
 
@@ -167,7 +280,9 @@ int manager_spawn_autovt(Manager *m, int vtnr);
 
 void manager_cgroup_notify_empty(Manager *m, const char *cgroup);
 
-void manager_gc(Manager *m, bool drop_not_started);
+int manager_gc(Manager *m, bool drop_not_started, bool sliced);
+unsigned manager_gc_queue_length(Manager *m);
+int manager_dispatch_session_setup(Manager *m);
 
 int manager_get_idle_hint(Manager *m, dual_timestamp *t);
 
@@ -179,7 +294,7 @@ extern const DBusObjectPathVTable bus_manager_vtable;
 
 DBusHandlerResult bus_message_filter(DBusConnection *c, DBusMessage *message, void *userdata);
 
-int bus_manager_shutdown_or_sleep_now_or_later(Manager *m, const char *unit_name, InhibitWhat w, DBusError *error);
+int bus_manager_shutdown_or_sleep_now_or_later(Manager *m, const char *unit_name, InhibitWhat w, DBusMessage *request);
 
 int manager_send_changed(Manager *manager, const char *properties);
 
@@ -0,0 +1,298 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+#include "mempool.h"
+#include "macro.h"
+#include "util.h"
+#include "list.h"
+
+/* Pools are allocated aligned to their size, which is a power of two,
+ * so that the pool of a tile can be found by masking its address. */
+struct pool {
+        struct mempool *mempool;
+
+        LIST_FIELDS(struct pool, pools);
+        LIST_FIELDS(struct pool, available);
+
+        void *freelist;
+        unsigned n_tiles;
+        unsigned n_carved;
+        unsigned n_used;
+};
+
+/* All mempools of this thread that ever allocated a pool, for
+ * trimming and stats */
+static __thread struct mempool *mempools = NULL;
+
+#define POOL_HEADER_SIZE ALIGN(sizeof(struct pool))
+
+static size_t mempool_pool_size(struct mempool *mp) {
+        size_t size;
+
+        if (_likely_(mp->pool_size > 0))
+                return mp->pool_size;
+
+        assert(mp->tile_size >= sizeof(void*));
+
+        /* Only depends on the tile type, hence the same for the
+         * instances of all threads */
+        size = page_size();
+        while (size < POOL_HEADER_SIZE + mp->at_least * mp->tile_size)
+                size <<= 1;
+
+        mp->pool_size = size;
+        return size;
+}
+
+static struct pool *pool_of_tile(struct mempool *mp, void *p) {
+        return (struct pool*) ((uintptr_t) p & ~((uintptr_t) mempool_pool_size(mp) - 1));
+}
+
+static struct pool *mempool_add_pool(struct mempool *mp) {
+        struct pool *p;
+        size_t size;
+
+        size = mempool_pool_size(mp);
+
+        if (posix_memalign((void**) &p, size, size) != 0)
+                return NULL;
+
+        if (_unlikely_(!mp->registered)) {
+                mp->next_mempool = mempools;
+                mempools = mp;
+                mp->registered = true;
+        }
+
+        p->mempool = mp;
+        p->freelist = NULL;
+        p->n_tiles = (mp->pool_size - POOL_HEADER_SIZE) / mp->tile_size;
+        p->n_carved = 0;
+        p->n_used = 0;
+
+        LIST_PREPEND(struct pool, pools, mp->pools, p);
+        LIST_PREPEND(struct pool, available, mp->available, p);
+        mp->n_pools++;
+        mp->n_empty++;
+
+        return p;
+}
+
+static void mempool_release_pool(struct mempool *mp, struct pool *p) {
+        assert(p->n_used == 0);
+
+        LIST_REMOVE(struct pool, pools, mp->pools, p);
+        LIST_REMOVE(struct pool, available, mp->available, p);
+        mp->n_pools--;
+        mp->n_empty--;
+
+        free(p);
+}
+
+static void mempool_free_local(struct mempool *mp, struct pool *pool, void *p) {
+        assert(pool->n_used > 0);
+
+        if (pool->n_used >= pool->n_tiles)
+                LIST_PREPEND(struct pool, available, mp->available, pool);
+
+        * (void**) p = pool->freelist;
+        pool->freelist = p;
+
+        if (--pool->n_used == 0)
+                mp->n_empty++;
+
+        mp->n_used--;
+}
+
+/* Takes back the tiles other threads freed into our pools */
+static void mempool_drain_remote(struct mempool *mp) {
+        void *p;
+
+        if (!__atomic_load_n(&mp->remote_freelist, __ATOMIC_RELAXED))
+                return;
+
+        p = __atomic_exchange_n(&mp->remote_freelist, NULL, __ATOMIC_ACQUIRE);
+        while (p) {
+                void *n;
+
+                n = * (void**) p;
+                mempool_free_local(mp, pool_of_tile(mp, p), p);
+                p = n;
+        }
+}
+
+void* mempool_alloc_tile(struct mempool *mp) {
+        struct pool *p;
+        void *r;
+
+        assert(mp);
+
+        p = mp->available;
+        if (_unlikely_(!p)) {
+                mempool_drain_remote(mp);
+
+                p = mp->available;
+                if (!p) {
+                        p = mempool_add_pool(mp);
+                        if (!p)
+                                return NULL;
+                }
+        }
+
+        if (p->freelist) {
+                r = p->freelist;
+                p->freelist = * (void**) r;
+        } else {
+                assert(p->n_carved < p->n_tiles);
+                r = ((uint8_t*) p) + POOL_HEADER_SIZE + p->n_carved * mp->tile_size;
+                p->n_carved++;
+        }
+
+        if (p->n_used++ == 0)
+                mp->n_empty--;
+
+        if (p->n_used >= p->n_tiles)
+                LIST_REMOVE(struct pool, available, mp->available, p);
+
+        mp->n_used++;
+
+        return r;
+}
+
+void* mempool_alloc0_tile(struct mempool *mp) {
+        void *p;
+
+        p = mempool_alloc_tile(mp);
+        if (p)
+                memset(p, 0, mp->tile_size);
+
+        return p;
+}
+
+void mempool_free_tile(struct mempool *mp, void *p) {
+        struct mempool *owner;
+        struct pool *pool;
+        void *head;
+
+        assert(mp);
+
+        if (!p)
+                return;
+
+        pool = pool_of_tile(mp, p);
+
+        if (_likely_(pool->mempool == mp)) {
+                mempool_free_local(mp, pool, p);
+                return;
+        }
+
+        /* The tile was allocated by another thread, push it onto the
+         * owner's remote free list, from where the owner takes it
+         * back the next time it runs out of tiles or trims. Only the
+         * owner ever pops, and it always takes the whole list, hence
+         * there is no ABA problem here. */
+        owner = pool->mempool;
+        head = __atomic_load_n(&owner->remote_freelist, __ATOMIC_RELAXED);
+        do
+                * (void**) p = head;
+        while (!__atomic_compare_exchange_n(&owner->remote_freelist, &head, p, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+size_t mempool_trim(struct mempool *mp) {
+        struct pool *p, *n;
+        bool kept = false;
+        size_t released = 0;
+
+        assert(mp);
+
+        mempool_drain_remote(mp);
+
+        if (mp->n_empty <= 1)
+                return 0;
+
+        /* Keep one empty pool around, so that a single object
+         * coming and going doesn't bounce a pool back and forth */
+        LIST_FOREACH_SAFE(available, p, n, mp->available) {
+                if (p->n_used > 0)
+                        continue;
+
+                if (!kept) {
+                        kept = true;
+                        continue;
+                }
+
+                mempool_release_pool(mp, p);
+                released += mp->pool_size;
+        }
+
+        return released;
+}
+
+size_t mempool_trim_all(void) {
+        struct mempool *mp;
+        size_t released = 0;
+
+        for (mp = mempools; mp; mp = mp->next_mempool)
+                released += mempool_trim(mp);
+
+        /* Have the heap hand the now free pages back to the kernel,
+         * with madvise(MADV_DONTNEED) where they can't be unmapped */
+        if (released > 0)
+                malloc_trim(0);
+
+        return released;
+}
+
+void mempool_get_stats(size_t *in_use, size_t *retained) {
+        struct mempool *mp;
+        size_t u = 0, r = 0;
+
+        for (mp = mempools; mp; mp = mp->next_mempool) {
+                u += mp->n_used * mp->tile_size;
+                r += mp->n_pools * mp->pool_size;
+        }
+
+        if (in_use)
+                *in_use = u;
+        if (retained)
+                *retained = r;
+}
+
+#ifdef VALGRIND
+
+void mempool_drop(struct mempool *mp) {
+        struct pool *p;
+
+        while ((p = mp->pools)) {
+                LIST_REMOVE(struct pool, pools, mp->pools, p);
+                free(p);
+        }
+
+        mp->available = NULL;
+        mp->n_pools = mp->n_empty = mp->n_used = 0;
+}
+
+#endif
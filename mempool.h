@@ -0,0 +1,76 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stddef.h>
+
+/* Fixed size tile allocator. Tiles are carved out of page-sized
+ * chunks and recycled through per-chunk free lists, which keeps the
+ * many small objects of one type close together and spares the heap
+ * from fragmenting. Chunks that became entirely unused are returned
+ * to the heap by mempool_trim().
+ *
+ * Pools defined with DEFINE_MEMPOOL() are per-thread. Tiles may be
+ * freed from any thread, tiles of another thread are handed back to
+ * it through a lock-free list. A thread must not exit while tiles it
+ * allocated are still in use. Trimming and stats cover the pools of
+ * the calling thread. */
+
+#include <stdbool.h>
+
+struct pool;
+
+struct mempool {
+        struct pool *pools;
+        struct pool *available;
+        struct mempool *next_mempool;
+        size_t tile_size;
+        size_t pool_size;
+        unsigned at_least;
+        unsigned n_pools;
+        unsigned n_empty;
+        unsigned n_used;
+        bool registered;
+
+        /* Tiles freed by other threads, pushed atomically */
+        void *remote_freelist;
+};
+
+void* mempool_alloc_tile(struct mempool *mp);
+void* mempool_alloc0_tile(struct mempool *mp);
+void mempool_free_tile(struct mempool *mp, void *p);
+
+/* Free all but one of the unused chunks, returns the bytes released */
+size_t mempool_trim(struct mempool *mp);
+size_t mempool_trim_all(void);
+
+/* Bytes handed out in tiles vs. bytes held in chunks, over all pools */
+void mempool_get_stats(size_t *in_use, size_t *retained);
+
+#define DEFINE_MEMPOOL(pool_name, tile_type, alloc_at_least)           \
+        static __thread struct mempool pool_name = {                    \
+                .tile_size = sizeof(tile_type),                         \
+                .at_least = alloc_at_least,                             \
+        }
+
+#ifdef VALGRIND
+void mempool_drop(struct mempool *mp);
+#endif
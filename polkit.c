@@ -27,54 +27,277 @@
 #include "dbus-common.h"
 #include "polkit.h"
 
-int verify_polkit(
-                DBusConnection *c,
-                DBusMessage *request,
+typedef struct PolkitResult {
+        char *action;
+        int r;
+        bool challenge;
+} PolkitResult;
+
+struct PolkitQuery {
+        Hashmap *registry;
+
+        DBusConnection *connection;
+        DBusMessage *request;
+        DBusObjectPathMessageFunction dispatch;
+        void *userdata;
+
+        /* The check currently in flight, if any */
+        DBusPendingCall *pending;
+        char *action;
+        bool interactive;
+
+        /* Subject of the check, for the cache */
+        PolkitCache *cache;
+        BusCreds creds;
+
+        /* Answers that already came in for this request */
+        PolkitResult *results;
+        unsigned n_results;
+};
+
+struct PolkitCacheEntry {
+        PolkitCache *cache;
+
+        pid_t pid;
+        unsigned long long starttime;
+        uid_t uid;
+        char *action;
+
+        char *sender;
+        bool authorized;
+        bool challenge;
+        usec_t until;
+
+        LIST_FIELDS(PolkitCacheEntry, lru);
+};
+
+static void polkit_cache_entry_unlink(PolkitCacheEntry *e) {
+        PolkitCache *c = e->cache;
+
+        if (c->lru_tail == e)
+                c->lru_tail = e->lru_prev;
+
+        LIST_REMOVE(PolkitCacheEntry, lru, c->lru, e);
+}
+
+static void polkit_cache_entry_free(PolkitCacheEntry *e) {
+        assert(e);
+
+        hashmap_remove(e->cache->entries, e);
+        polkit_cache_entry_unlink(e);
+
+        free(e->action);
+        free(e->sender);
+        free(e);
+}
+
+void polkit_cache_init(PolkitCache *c, unsigned max_entries, usec_t ttl) {
+        assert(c);
+
+        zero(*c);
+        c->max_entries = max_entries;
+        c->ttl = ttl;
+}
+
+void polkit_cache_flush(PolkitCache *c) {
+        assert(c);
+
+        while (c->lru)
+                polkit_cache_entry_free(c->lru);
+}
+
+void polkit_cache_done(PolkitCache *c) {
+        assert(c);
+
+        polkit_cache_flush(c);
+
+        hashmap_free(c->entries);
+        c->entries = NULL;
+}
+
+void polkit_cache_forget_sender(PolkitCache *c, const char *sender) {
+        PolkitCacheEntry *e, *n;
+
+        assert(c);
+        assert(sender);
+
+        LIST_FOREACH_SAFE(lru, e, n, c->lru)
+                if (streq_ptr(e->sender, sender))
+                        polkit_cache_entry_free(e);
+}
+
+#ifdef ENABLE_POLKIT
+static unsigned polkit_cache_entry_hash_func(const void *p) {
+        const PolkitCacheEntry *e = p;
+        unsigned h;
+
+        h = string_hash_func(e->action);
+        h = h * 31 + memory_hash_func(&e->pid, sizeof(e->pid));
+        h = h * 31 + memory_hash_func(&e->starttime, sizeof(e->starttime));
+        h = h * 31 + memory_hash_func(&e->uid, sizeof(e->uid));
+
+        return h;
+}
+
+static int polkit_cache_entry_compare_func(const void *a, const void *b) {
+        const PolkitCacheEntry *x = a, *y = b;
+
+        if (x->pid != y->pid)
+                return x->pid < y->pid ? -1 : 1;
+        if (x->starttime != y->starttime)
+                return x->starttime < y->starttime ? -1 : 1;
+        if (x->uid != y->uid)
+                return x->uid < y->uid ? -1 : 1;
+
+        return strcmp(x->action, y->action);
+}
+
+static void polkit_cache_entry_link(PolkitCacheEntry *e) {
+        PolkitCache *c = e->cache;
+
+        LIST_PREPEND(PolkitCacheEntry, lru, c->lru, e);
+
+        if (!c->lru_tail)
+                c->lru_tail = e;
+}
+
+static int polkit_cache_get(
+                PolkitCache *c,
+                const BusCreds *creds,
                 const char *action,
                 bool interactive,
-                bool *_challenge,
-                DBusError *error) {
+                bool *challenge) {
 
+        PolkitCacheEntry k, *e;
 
-#ifdef ENABLE_POLKIT
-        DBusMessage *m = NULL, *reply = NULL;
-        const char *unix_process = "unix-process", *pid = "pid", *starttime = "start-time", *cancel_id = "";
-        uint32_t flags = interactive ? 1 : 0;
-        pid_t pid_raw;
-        uint32_t pid_u32;
-        unsigned long long starttime_raw;
-        uint64_t starttime_u64;
-        DBusMessageIter iter_msg, iter_struct, iter_array, iter_dict, iter_variant;
+        assert(c);
+        assert(action);
+        assert(challenge);
+
+        if (c->max_entries <= 0 || c->ttl <= 0)
+                return -ENOENT;
+
+        k.pid = creds->pid;
+        k.starttime = creds->starttime;
+        k.uid = creds->uid;
+        k.action = (char*) action;
+
+        e = hashmap_get(c->entries, &k);
+        if (e && e->until <= now(CLOCK_MONOTONIC)) {
+                polkit_cache_entry_free(e);
+                e = NULL;
+        }
+
+        /* A non-interactive "no" doesn't tell us what the user would
+         * say when asked, so only a "yes" is good for interactive
+         * checks */
+        if (!e || (interactive && !e->authorized)) {
+                c->n_misses++;
+                return -ENOENT;
+        }
+
+        c->n_hits++;
+
+        polkit_cache_entry_unlink(e);
+        polkit_cache_entry_link(e);
+
+        *challenge = e->challenge;
+        return e->authorized;
+}
+
+static int polkit_cache_put(
+                PolkitCache *c,
+                const BusCreds *creds,
+                const char *action,
+                const char *sender,
+                bool authorized,
+                bool challenge) {
+
+        PolkitCacheEntry k, *e;
+        char *s = NULL;
         int r;
-        dbus_bool_t authorized = FALSE, challenge = FALSE;
-#endif
-        const char *sender;
-        unsigned long ul;
 
         assert(c);
-        assert(request);
+        assert(action);
 
-        sender = dbus_message_get_sender(request);
-        if (!sender)
-                return -EINVAL;
+        if (c->max_entries <= 0 || c->ttl <= 0)
+                return 0;
 
-        ul = dbus_bus_get_unix_user(c, sender, error);
-        if (ul == (unsigned long) -1)
-                return -EINVAL;
+        if (sender) {
+                s = strdup(sender);
+                if (!s)
+                        return -ENOMEM;
+        }
 
-        /* Shortcut things for root, to avoid the PK roundtrip and dependency */
-        if (ul == 0)
-                return 1;
+        k.pid = creds->pid;
+        k.starttime = creds->starttime;
+        k.uid = creds->uid;
+        k.action = (char*) action;
+
+        e = hashmap_get(c->entries, &k);
+        if (e)
+                polkit_cache_entry_unlink(e);
+        else {
+                while (hashmap_size(c->entries) >= c->max_entries && c->lru_tail)
+                        polkit_cache_entry_free(c->lru_tail);
+
+                r = hashmap_ensure_allocated(&c->entries, polkit_cache_entry_hash_func, polkit_cache_entry_compare_func);
+                if (r < 0)
+                        goto fail;
+
+                e = new0(PolkitCacheEntry, 1);
+                if (!e) {
+                        r = -ENOMEM;
+                        goto fail;
+                }
 
-#ifdef ENABLE_POLKIT
+                e->cache = c;
+                e->pid = creds->pid;
+                e->starttime = creds->starttime;
+                e->uid = creds->uid;
 
-        pid_raw = bus_get_unix_process_id(c, sender, error);
-        if (pid_raw == 0)
-                return -EINVAL;
+                e->action = strdup(action);
+                if (!e->action) {
+                        free(e);
+                        r = -ENOMEM;
+                        goto fail;
+                }
 
-        r = get_starttime_of_pid(pid_raw, &starttime_raw);
-        if (r < 0)
-                return r;
+                r = hashmap_put(c->entries, e, e);
+                if (r < 0) {
+                        free(e->action);
+                        free(e);
+                        goto fail;
+                }
+        }
+
+        free(e->sender);
+        e->sender = s;
+        e->authorized = authorized;
+        e->challenge = challenge;
+        e->until = now(CLOCK_MONOTONIC) + c->ttl;
+
+        polkit_cache_entry_link(e);
+        return 0;
+
+fail:
+        free(s);
+        return r;
+}
+
+static int check_authorization_new(
+                pid_t pid_raw,
+                unsigned long long starttime_raw,
+                const char *action,
+                bool interactive,
+                DBusMessage **_m) {
+
+        const char *unix_process = "unix-process", *pid = "pid", *starttime = "start-time", *cancel_id = "";
+        uint32_t flags = interactive ? 1 : 0;
+        uint32_t pid_u32;
+        uint64_t starttime_u64;
+        DBusMessageIter iter_msg, iter_struct, iter_array, iter_dict, iter_variant;
+        DBusMessage *m;
 
         m = dbus_message_new_method_call(
                         "org.freedesktop.PolicyKit1",
@@ -111,61 +334,269 @@ int verify_polkit(
             !dbus_message_iter_close_container(&iter_msg, &iter_array) ||
             !dbus_message_iter_append_basic(&iter_msg, DBUS_TYPE_UINT32, &flags) ||
             !dbus_message_iter_append_basic(&iter_msg, DBUS_TYPE_STRING, &cancel_id)) {
-                r = -ENOMEM;
-                goto finish;
+                dbus_message_unref(m);
+                return -ENOMEM;
         }
 
-        reply = dbus_connection_send_with_reply_and_block(c, m, -1, error);
-        if (!reply) {
-
-                /* Treat no PK available as access denied */
-                if (dbus_error_has_name(error, DBUS_ERROR_SERVICE_UNKNOWN)) {
-                        r = -EACCES;
-                        dbus_error_free(error);
-                        goto finish;
-                }
+        *_m = m;
+        return 0;
+}
 
-                r = -EIO;
-                goto finish;
-        }
+static int check_authorization_reply(DBusMessage *reply, bool *_challenge) {
+        DBusMessageIter iter_msg, iter_struct;
+        dbus_bool_t authorized = FALSE, challenge = FALSE;
 
         if (!dbus_message_iter_init(reply, &iter_msg) ||
-            dbus_message_iter_get_arg_type(&iter_msg) != DBUS_TYPE_STRUCT) {
-                r = -EIO;
-                goto finish;
-        }
+            dbus_message_iter_get_arg_type(&iter_msg) != DBUS_TYPE_STRUCT)
+                return -EIO;
 
         dbus_message_iter_recurse(&iter_msg, &iter_struct);
 
-        if (dbus_message_iter_get_arg_type(&iter_struct) != DBUS_TYPE_BOOLEAN) {
-                r = -EIO;
-                goto finish;
-        }
+        if (dbus_message_iter_get_arg_type(&iter_struct) != DBUS_TYPE_BOOLEAN)
+                return -EIO;
 
         dbus_message_iter_get_basic(&iter_struct, &authorized);
 
         if (!dbus_message_iter_next(&iter_struct) ||
-            dbus_message_iter_get_arg_type(&iter_struct) != DBUS_TYPE_BOOLEAN) {
+            dbus_message_iter_get_arg_type(&iter_struct) != DBUS_TYPE_BOOLEAN)
+                return -EIO;
+
+        dbus_message_iter_get_basic(&iter_struct, &challenge);
+
+        *_challenge = !!challenge;
+        return !!authorized;
+}
+#endif
+
+static int check_authorization_result(int r, bool challenge, bool *_challenge) {
+
+        if (r != 0)
+                return r;
+
+        if (!_challenge)
+                return -EPERM;
+
+        *_challenge = challenge;
+        return 0;
+}
+
+static void polkit_query_free(PolkitQuery *q) {
+        unsigned i;
+
+        if (!q)
+                return;
+
+        if (q->registry)
+                hashmap_remove(q->registry, q->request);
+
+        if (q->pending) {
+                dbus_pending_call_cancel(q->pending);
+                dbus_pending_call_unref(q->pending);
+        }
+
+        for (i = 0; i < q->n_results; i++)
+                free(q->results[i].action);
+        free(q->results);
+
+        free(q->action);
+
+        if (q->request)
+                dbus_message_unref(q->request);
+
+        if (q->connection)
+                dbus_connection_unref(q->connection);
+
+        free(q);
+}
+
+void polkit_registry_free(Hashmap *registry) {
+        PolkitQuery *q;
+
+        while ((q = hashmap_first(registry)))
+                polkit_query_free(q);
+
+        hashmap_free(registry);
+}
+
+#ifdef ENABLE_POLKIT
+static void polkit_query_notify(DBusPendingCall *pending, void *userdata) {
+        PolkitQuery *q = userdata;
+        DBusMessage *reply;
+        PolkitResult *t;
+        bool challenge = false;
+        int r;
+
+        assert(q);
+        assert(q->pending == pending);
+
+        reply = dbus_pending_call_steal_reply(pending);
+        dbus_pending_call_unref(q->pending);
+        q->pending = NULL;
+
+        if (!reply)
                 r = -EIO;
+        else if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+
+                /* Treat no PK available as access denied */
+                if (dbus_message_is_error(reply, DBUS_ERROR_SERVICE_UNKNOWN))
+                        r = -EACCES;
+                else
+                        r = -EIO;
+        } else
+                r = check_authorization_reply(reply, &challenge);
+
+        if (reply)
+                dbus_message_unref(reply);
+
+        if (q->cache && !q->interactive && r >= 0)
+                polkit_cache_put(q->cache, &q->creds, q->action,
+                                 dbus_message_get_sender(q->request), r > 0, challenge);
+
+        t = realloc(q->results, sizeof(PolkitResult) * (q->n_results + 1));
+        if (!t) {
+                log_oom();
                 goto finish;
         }
 
-        dbus_message_iter_get_basic(&iter_struct, &challenge);
+        q->results = t;
+        t[q->n_results].action = q->action;
+        t[q->n_results].r = r;
+        t[q->n_results].challenge = challenge;
+        q->n_results++;
+        q->action = NULL;
 
-        if (authorized)
-                r = 1;
-        else if (_challenge) {
-                *_challenge = !!challenge;
-                r = 0;
-        } else
-                r = -EPERM;
+        /* Run the original method again; this time the check will be
+         * answered from the results we just stored. */
+        q->dispatch(q->connection, q->request, q->userdata);
+
+        /* The method might have needed yet another check, in which
+         * case we stay around until that one is answered too. */
+        if (q->pending)
+                return;
 
 finish:
+        polkit_query_free(q);
+}
+#endif
+
+int verify_polkit_async(
+                DBusConnection *c,
+                DBusMessage *request,
+                const char *action,
+                bool interactive,
+                bool *_challenge,
+                const BusCreds *creds,
+                Hashmap **registry,
+                PolkitCache *cache,
+                DBusObjectPathMessageFunction dispatch,
+                void *userdata) {
+
+#ifdef ENABLE_POLKIT
+        DBusMessage *m = NULL;
+        DBusPendingCall *pending = NULL;
+        bool allocated = false, challenge = false;
+        int r;
+#endif
+        PolkitQuery *q;
+        unsigned i;
+
+        assert(c);
+        assert(request);
+        assert(action);
+        assert(creds);
+        assert(registry);
+        assert(dispatch);
+
+        q = hashmap_get(*registry, request);
+        if (q) {
+                assert(!q->pending);
+
+                for (i = 0; i < q->n_results; i++)
+                        if (streq(q->results[i].action, action))
+                                return check_authorization_result(q->results[i].r, q->results[i].challenge, _challenge);
+        }
+
+        /* Shortcut things for root, to avoid the PK roundtrip and dependency */
+        if (creds->uid == 0)
+                return 1;
+
+#ifdef ENABLE_POLKIT
+
+        if (cache) {
+                r = polkit_cache_get(cache, creds, action, interactive, &challenge);
+                if (r >= 0)
+                        return check_authorization_result(r, challenge, _challenge);
+        }
+
+        if (!q) {
+                r = hashmap_ensure_allocated(registry, trivial_hash_func, trivial_compare_func);
+                if (r < 0)
+                        return r;
+
+                q = new0(PolkitQuery, 1);
+                if (!q)
+                        return -ENOMEM;
+
+                q->connection = dbus_connection_ref(c);
+                q->request = dbus_message_ref(request);
+                q->dispatch = dispatch;
+                q->userdata = userdata;
+
+                r = hashmap_put(*registry, request, q);
+                if (r < 0) {
+                        polkit_query_free(q);
+                        return r;
+                }
+
+                q->registry = *registry;
+                allocated = true;
+        }
+
+        r = check_authorization_new(creds->pid, creds->starttime, action, interactive, &m);
+        if (r < 0)
+                goto fail;
+
+        q->action = strdup(action);
+        if (!q->action) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        if (!dbus_connection_send_with_reply(c, m, &pending, -1)) {
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        if (!pending) {
+                r = -ENOTCONN;
+                goto fail;
+        }
+
+        if (!dbus_pending_call_set_notify(pending, polkit_query_notify, q, NULL)) {
+                dbus_pending_call_cancel(pending);
+                dbus_pending_call_unref(pending);
+                r = -ENOMEM;
+                goto fail;
+        }
+
+        q->pending = pending;
+        q->interactive = interactive;
+        q->cache = cache;
+        q->creds = *creds;
+
+        dbus_message_unref(m);
+
+        return -EINPROGRESS;
+
+fail:
         if (m)
                 dbus_message_unref(m);
 
-        if (reply)
-                dbus_message_unref(reply);
+        free(q->action);
+        q->action = NULL;
+
+        if (allocated)
+                polkit_query_free(q);
 
         return r;
 #else
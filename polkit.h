@@ -22,12 +22,59 @@
 ***/
 
 #include <stdbool.h>
+#include <sys/types.h>
 #include <dbus/dbus.h>
 
-int verify_polkit(
+#include "hashmap.h"
+#include "dbus-creds.h"
+#include "list.h"
+#include "time-util.h"
+
+typedef struct PolkitQuery PolkitQuery;
+typedef struct PolkitCache PolkitCache;
+typedef struct PolkitCacheEntry PolkitCacheEntry;
+
+/* Remembers non-interactive polkit answers per subject process and
+ * action for a short while. The start time in the key protects
+ * against PID reuse, the TTL against decisions that change without
+ * polkit telling us (for example a session becoming inactive). */
+struct PolkitCache {
+        Hashmap *entries;
+
+        /* Most recently used first */
+        LIST_HEAD(PolkitCacheEntry, lru);
+        PolkitCacheEntry *lru_tail;
+
+        unsigned max_entries;
+        usec_t ttl;
+
+        uint64_t n_hits;
+        uint64_t n_misses;
+};
+
+void polkit_cache_init(PolkitCache *c, unsigned max_entries, usec_t ttl);
+void polkit_cache_done(PolkitCache *c);
+void polkit_cache_flush(PolkitCache *c);
+void polkit_cache_forget_sender(PolkitCache *c, const char *sender);
+
+/* Checks whether the sender of request may perform action. Never
+ * waits for polkit, and expects the sender's credentials to be known
+ * already. If a roundtrip is necessary the request is parked in
+ * *registry and -EINPROGRESS is returned; the caller should then
+ * return without replying. Once polkit answered, dispatch() is called
+ * again for the same request, and the same verify_polkit_async() call
+ * returns the answer. Non-interactive answers are kept in the cache,
+ * if one is passed. */
+int verify_polkit_async(
                 DBusConnection *c,
                 DBusMessage *request,
                 const char *action,
                 bool interactive,
                 bool *challenge,
-                DBusError *error);
+                const BusCreds *creds,
+                Hashmap **registry,
+                PolkitCache *cache,
+                DBusObjectPathMessageFunction dispatch,
+                void *userdata);
+
+void polkit_registry_free(Hashmap *registry);
@@ -0,0 +1,92 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <string.h>
+#include <endian.h>
+
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                        \
+        do {                                                            \
+                v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+                v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                  \
+                v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                  \
+                v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+        } while(0)
+
+static inline uint64_t read_le64(const uint8_t *p) {
+        uint64_t u;
+
+        memcpy(&u, p, sizeof(u));
+        return le64toh(u);
+}
+
+uint64_t siphash13(const void *in, size_t inlen, const uint8_t k[16]) {
+        uint64_t v0 = 0x736f6d6570736575ULL;
+        uint64_t v1 = 0x646f72616e646f6dULL;
+        uint64_t v2 = 0x6c7967656e657261ULL;
+        uint64_t v3 = 0x7465646279746573ULL;
+        uint64_t k0, k1, m, b;
+        const uint8_t *p = in, *end;
+
+        k0 = read_le64(k);
+        k1 = read_le64(k + 8);
+
+        v3 ^= k1;
+        v2 ^= k0;
+        v1 ^= k1;
+        v0 ^= k0;
+
+        /* Process the input a word at a time, one compression round
+         * per word */
+        for (end = p + (inlen & ~(size_t) 7); p < end; p += 8) {
+                m = read_le64(p);
+
+                v3 ^= m;
+                SIPROUND;
+                v0 ^= m;
+        }
+
+        b = ((uint64_t) inlen) << 56;
+
+        switch (inlen & 7) {
+        case 7: b |= ((uint64_t) p[6]) << 48;
+        case 6: b |= ((uint64_t) p[5]) << 40;
+        case 5: b |= ((uint64_t) p[4]) << 32;
+        case 4: b |= ((uint64_t) p[3]) << 24;
+        case 3: b |= ((uint64_t) p[2]) << 16;
+        case 2: b |= ((uint64_t) p[1]) << 8;
+        case 1: b |= ((uint64_t) p[0]);
+        case 0: break;
+        }
+
+        v3 ^= b;
+        SIPROUND;
+        v0 ^= b;
+
+        /* Three finalization rounds */
+        v2 ^= 0xff;
+        SIPROUND;
+        SIPROUND;
+        SIPROUND;
+
+        return v0 ^ v1 ^ v2 ^ v3;
+}
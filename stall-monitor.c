@@ -0,0 +1,206 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <execinfo.h>
+
+#include "log.h"
+#include "stall-monitor.h"
+
+static void stall_monitor_write_backtrace(int sig) {
+        static const char header[] = "Main loop stalled, backtrace:\n";
+        void *frames[64];
+        int n;
+
+        /* Runs on the main thread, in the middle of the stalled
+         * handler. backtrace_symbols_fd() is not async-signal-safe,
+         * which is why this is opt-in and only meant for debugging. */
+        write(STDERR_FILENO, header, sizeof(header) - 1);
+
+        n = backtrace(frames, ELEMENTSOF(frames));
+        backtrace_symbols_fd(frames, n, STDERR_FILENO);
+}
+
+static void *stall_monitor_thread(void *p) {
+        StallMonitor *s = p;
+        unsigned long reported = 0;
+
+        pthread_mutex_lock(&s->mutex);
+
+        while (!s->stop) {
+                struct timespec deadline;
+                usec_t n;
+
+                if (!s->busy || s->seq == reported) {
+                        s->waiting = true;
+                        pthread_cond_wait(&s->cond, &s->mutex);
+                        s->waiting = false;
+                        continue;
+                }
+
+                n = now(CLOCK_MONOTONIC);
+                if (n < s->start + s->threshold) {
+                        timespec_store(&deadline, s->start + s->threshold);
+                        pthread_cond_timedwait(&s->cond, &s->mutex, &deadline);
+                        continue;
+                }
+
+                /* Still in the same dispatch past the threshold, get
+                 * its backtrace once. The stall itself is logged by
+                 * the main thread when the dispatch returns, log.c
+                 * isn't safe to use from here. */
+                reported = s->seq;
+                pthread_kill(s->main_thread, SIGRTMIN);
+        }
+
+        pthread_mutex_unlock(&s->mutex);
+
+        return NULL;
+}
+
+void stall_monitor_init(StallMonitor *s) {
+        assert(s);
+
+        zero(*s);
+}
+
+int stall_monitor_start(StallMonitor *s, usec_t threshold, bool write_backtrace) {
+        struct sigaction sa = {
+                .sa_handler = stall_monitor_write_backtrace,
+                .sa_flags = SA_RESTART,
+        };
+        pthread_condattr_t attr;
+        sigset_t mask, old;
+        void *frame;
+        int r;
+
+        assert(s);
+        assert(!s->running);
+
+        s->threshold = threshold;
+
+        /* Without backtraces stalls are only reported when they
+         * end, which needs no thread */
+        if (threshold <= 0 || !write_backtrace)
+                return 0;
+
+        s->main_thread = pthread_self();
+
+        /* The first backtrace() may load libgcc, which is not
+         * something to do in a signal handler */
+        backtrace(&frame, 1);
+
+        if (sigaction(SIGRTMIN, &sa, NULL) < 0)
+                return -errno;
+
+        pthread_mutex_init(&s->mutex, NULL);
+
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&s->cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        /* Leave all signals to the main thread */
+        assert_se(sigfillset(&mask) == 0);
+        assert_se(pthread_sigmask(SIG_SETMASK, &mask, &old) == 0);
+
+        r = pthread_create(&s->thread, NULL, stall_monitor_thread, s);
+
+        assert_se(pthread_sigmask(SIG_SETMASK, &old, NULL) == 0);
+
+        if (r != 0) {
+                pthread_cond_destroy(&s->cond);
+                pthread_mutex_destroy(&s->mutex);
+                return -r;
+        }
+
+        s->running = true;
+        return 0;
+}
+
+void stall_monitor_stop(StallMonitor *s) {
+        assert(s);
+
+        if (!s->running)
+                return;
+
+        pthread_mutex_lock(&s->mutex);
+        s->stop = true;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+
+        pthread_join(s->thread, NULL);
+
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->mutex);
+
+        s->running = false;
+}
+
+void stall_monitor_enter(StallMonitor *s, const char *handler, usec_t start) {
+        assert(s);
+        assert(handler);
+
+        if (s->threshold <= 0)
+                return;
+
+        if (!s->running) {
+                strncpy(s->handler, handler, sizeof(s->handler) - 1);
+                s->start = start;
+                return;
+        }
+
+        pthread_mutex_lock(&s->mutex);
+
+        strncpy(s->handler, handler, sizeof(s->handler) - 1);
+        s->start = start;
+        s->seq++;
+        s->busy = true;
+
+        /* Only wake the monitor if it went to sleep for good, if it
+         * waits for an earlier dispatch it will pick this one up
+         * when that times out */
+        if (s->waiting)
+                pthread_cond_signal(&s->cond);
+
+        pthread_mutex_unlock(&s->mutex);
+}
+
+void stall_monitor_leave(StallMonitor *s, usec_t end) {
+        char ts[FORMAT_TIMESPAN_MAX];
+
+        assert(s);
+
+        if (s->threshold <= 0)
+                return;
+
+        if (s->running) {
+                pthread_mutex_lock(&s->mutex);
+                s->busy = false;
+                pthread_mutex_unlock(&s->mutex);
+        }
+
+        /* Only this thread changes the dispatch fields */
+        if (end >= s->start + s->threshold)
+                log_warning("Main loop stalled, %s blocked it for %s.",
+                            s->handler, format_timespan(ts, sizeof(ts), end - s->start, USEC_PER_MSEC));
+}
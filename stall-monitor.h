@@ -0,0 +1,74 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "util.h"
+
+/* Detects handlers that block the main loop. The main loop marks the
+ * begin and end of each dispatch, and logs dispatches that took
+ * longer than the threshold when they return. If asked to, a monitor
+ * thread that sleeps until a dispatch has been running for longer
+ * than the threshold also makes the main thread write its backtrace
+ * to stderr while it is still stuck. That happens from a signal
+ * handler and uses backtrace_symbols_fd(), which is not
+ * async-signal-safe, so it is off by default and meant for debugging
+ * only. The monitor only wakes up once per threshold at most while
+ * the loop is busy, and not at all while it is idle. It never logs,
+ * all logging happens on the main thread. */
+
+#define STALL_MONITOR_HANDLER_MAX 64
+
+typedef struct StallMonitor {
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+        pthread_t thread;
+        pthread_t main_thread;
+
+        usec_t threshold;
+        bool backtrace;
+
+        bool running;
+        bool stop;
+
+        /* The monitor thread sleeps until the next dispatch */
+        bool waiting;
+
+        /* The dispatch in progress, if busy */
+        bool busy;
+        unsigned long seq;
+        usec_t start;
+        char handler[STALL_MONITOR_HANDLER_MAX];
+} StallMonitor;
+
+void stall_monitor_init(StallMonitor *s);
+
+/* Enables the monitor, unless threshold is 0, and starts the monitor
+ * thread if write_backtrace is set. Must be called from the thread
+ * running the main loop. */
+int stall_monitor_start(StallMonitor *s, usec_t threshold, bool write_backtrace);
+void stall_monitor_stop(StallMonitor *s);
+
+/* Brackets a dispatch, with the time it began and ended */
+void stall_monitor_enter(StallMonitor *s, const char *handler, usec_t start);
+void stall_monitor_leave(StallMonitor *s, usec_t end);
@@ -0,0 +1,260 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <errno.h>
+#include <sys/timerfd.h>
+
+#include "timer-queue.h"
+
+#define TIMER_IDX_INVALID ((unsigned) -1)
+
+/* The latest time t may fire at, which orders the heap, so that the
+ * top of the heap bounds the wakeup of every pending timer */
+static usec_t timer_latest(Timer *t) {
+        usec_t latest;
+
+        latest = t->deadline + t->slack;
+        if (latest < t->deadline)
+                return (usec_t) -1;
+
+        return latest;
+}
+
+static void heap_swap(TimerQueue *q, unsigned a, unsigned b) {
+        Timer *t;
+
+        t = q->heap[a];
+        q->heap[a] = q->heap[b];
+        q->heap[b] = t;
+
+        q->heap[a]->idx = a;
+        q->heap[b]->idx = b;
+}
+
+static void heap_up(TimerQueue *q, unsigned i) {
+        while (i > 0) {
+                unsigned p = (i - 1) / 2;
+
+                if (timer_latest(q->heap[p]) <= timer_latest(q->heap[i]))
+                        break;
+
+                heap_swap(q, i, p);
+                i = p;
+        }
+}
+
+static void heap_down(TimerQueue *q, unsigned i) {
+        for (;;) {
+                unsigned l = 2 * i + 1, r = l + 1, k = i;
+
+                if (l < q->n_timers && timer_latest(q->heap[l]) < timer_latest(q->heap[k]))
+                        k = l;
+                if (r < q->n_timers && timer_latest(q->heap[r]) < timer_latest(q->heap[k]))
+                        k = r;
+
+                if (k == i)
+                        break;
+
+                heap_swap(q, i, k);
+                i = k;
+        }
+}
+
+void timer_queue_init(TimerQueue *q) {
+        assert(q);
+
+        zero(*q);
+        q->fd = -1;
+        q->now = now(CLOCK_MONOTONIC);
+}
+
+int timer_queue_open(TimerQueue *q) {
+        assert(q);
+        assert(q->fd < 0);
+
+        q->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+        if (q->fd < 0)
+                return -errno;
+
+        q->armed = 0;
+        return q->fd;
+}
+
+void timer_queue_done(TimerQueue *q) {
+        assert(q);
+
+        while (q->n_timers > 0)
+                timer_stop(q, q->heap[0]);
+
+        free(q->heap);
+        q->heap = NULL;
+        q->allocated = 0;
+
+        if (q->fd >= 0) {
+                close_nointr_nofail(q->fd);
+                q->fd = -1;
+        }
+}
+
+/* Picks the latest coarse boundary in [deadline, deadline + slack],
+ * so that timers with similar deadlines and enough slack share one
+ * wakeup */
+static usec_t timer_wakeup(Timer *t) {
+        static const usec_t granularity[] = {
+                USEC_PER_MINUTE,
+                10 * USEC_PER_SEC,
+                USEC_PER_SEC,
+                250 * USEC_PER_MSEC,
+        };
+        usec_t latest;
+        unsigned i;
+
+        if (t->slack <= 0)
+                return t->deadline;
+
+        latest = timer_latest(t);
+
+        for (i = 0; i < ELEMENTSOF(granularity); i++) {
+                usec_t c;
+
+                c = latest - latest % granularity[i];
+                if (c >= t->deadline)
+                        return c;
+        }
+
+        return latest;
+}
+
+int timer_queue_arm(TimerQueue *q) {
+        struct itimerspec its = {};
+        usec_t w;
+
+        assert(q);
+        assert(q->fd >= 0);
+
+        /* The top timer has the earliest latest fire time, hence
+         * waking up for it is never too late for any other */
+        w = q->n_timers > 0 ? MAX(timer_wakeup(q->heap[0]), (usec_t) 1) : 0;
+        if (w == q->armed)
+                return 0;
+
+        /* Zero disarms the timer, hence nothing pending means no
+         * wakeups at all */
+        timespec_store(&its.it_value, w);
+
+        if (timerfd_settime(q->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+                return -errno;
+
+        q->armed = w;
+        return 0;
+}
+
+void timer_queue_dispatch(TimerQueue *q) {
+        assert(q);
+
+        flush_fd(q->fd);
+        q->armed = 0;
+
+        /* Timers that are due but have more slack than the top one
+         * stay queued, they are still covered by a later wakeup */
+        while (q->n_timers > 0 && q->heap[0]->deadline <= q->now) {
+                Timer *t = q->heap[0];
+
+                /* The callback may free or restart the timer */
+                timer_stop(q, t);
+                t->callback(t, t->userdata);
+        }
+}
+
+void timer_queue_update_now(TimerQueue *q) {
+        assert(q);
+
+        q->now = now(CLOCK_MONOTONIC);
+}
+
+usec_t timer_queue_now(TimerQueue *q) {
+        assert(q);
+
+        return q->now;
+}
+
+void timer_init(Timer *t, timer_callback_t callback, void *userdata) {
+        assert(t);
+        assert(callback);
+
+        zero(*t);
+        t->idx = TIMER_IDX_INVALID;
+        t->callback = callback;
+        t->userdata = userdata;
+}
+
+int timer_start(TimerQueue *q, Timer *t, usec_t deadline, usec_t slack) {
+        assert(q);
+        assert(t);
+        assert(t->callback);
+
+        if (t->idx == TIMER_IDX_INVALID) {
+                if (!GREEDY_REALLOC(q->heap, q->allocated, q->n_timers + 1))
+                        return -ENOMEM;
+
+                t->idx = q->n_timers++;
+                q->heap[t->idx] = t;
+        }
+
+        t->deadline = deadline;
+        t->slack = slack;
+
+        heap_up(q, t->idx);
+        heap_down(q, t->idx);
+
+        return 0;
+}
+
+void timer_stop(TimerQueue *q, Timer *t) {
+        unsigned i;
+
+        assert(q);
+        assert(t);
+
+        i = t->idx;
+        if (i == TIMER_IDX_INVALID)
+                return;
+
+        assert(i < q->n_timers);
+        assert(q->heap[i] == t);
+
+        t->idx = TIMER_IDX_INVALID;
+
+        q->n_timers--;
+        if (i == q->n_timers)
+                return;
+
+        q->heap[i] = q->heap[q->n_timers];
+        q->heap[i]->idx = i;
+
+        heap_up(q, i);
+        heap_down(q, i);
+}
+
+bool timer_is_pending(Timer *t) {
+        assert(t);
+
+        return t->idx != TIMER_IDX_INVALID;
+}
@@ -0,0 +1,80 @@
+/*-*- Mode: C; c-basic-offset: 8; indent-tabs-mode: nil -*-*/
+
+#pragma once
+
+/***
+  This file is part of logoutd.
+
+  logoutd is free software; you can redistribute it and/or modify it
+  under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation; either version 2.1 of the License, or
+  (at your option) any later version.
+
+  logoutd is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with logoutd; If not, see <http://www.gnu.org/licenses/>.
+***/
+
+
+#include <stdbool.h>
+
+#include "util.h"
+
+/* Timers kept in a min-heap by deadline plus slack, i.e. by the
+ * latest time each may fire at, and driven by a single
+ * timerfd, which is only armed while a timer is pending. Each timer
+ * may fire up to its slack late, which is used to align wakeups to
+ * coarse boundaries, so that timers due around the same time expire
+ * together. The queue caches CLOCK_MONOTONIC per loop iteration, see
+ * timer_queue_update_now(). */
+
+typedef struct TimerQueue TimerQueue;
+typedef struct Timer Timer;
+
+typedef void (*timer_callback_t)(Timer *t, void *userdata);
+
+struct Timer {
+        usec_t deadline;
+        usec_t slack;
+        unsigned idx;
+
+        timer_callback_t callback;
+        void *userdata;
+};
+
+struct TimerQueue {
+        Timer **heap;
+        unsigned n_timers;
+        size_t allocated;
+
+        int fd;
+        usec_t armed;
+        usec_t now;
+};
+
+void timer_queue_init(TimerQueue *q);
+int timer_queue_open(TimerQueue *q);
+void timer_queue_done(TimerQueue *q);
+
+/* Programs the timerfd for the next expiry, to be called before
+ * going to sleep */
+int timer_queue_arm(TimerQueue *q);
+
+/* Runs the callbacks of all expired timers, to be called when the
+ * timerfd becomes readable */
+void timer_queue_dispatch(TimerQueue *q);
+
+void timer_queue_update_now(TimerQueue *q);
+usec_t timer_queue_now(TimerQueue *q) _pure_;
+
+void timer_init(Timer *t, timer_callback_t callback, void *userdata);
+
+/* Schedules t to expire at the absolute monotonic time deadline, or
+ * up to slack later. Reschedules t if it is pending already. */
+int timer_start(TimerQueue *q, Timer *t, usec_t deadline, usec_t slack);
+void timer_stop(TimerQueue *q, Timer *t);
+bool timer_is_pending(Timer *t) _pure_;
@@ -1365,10 +1365,11 @@ char *xescape(const char *s, const char *bad) {
         return r;
 }
 
-char *bus_path_escape(const char *s) {
-        char *r, *t;
+char *bus_path_escape_to(char *buf, const char *s) {
+        char *t;
         const char *f;
 
+        assert(buf);
         assert(s);
 
         /* Escapes all chars that D-Bus' object path cannot deal
@@ -1376,13 +1377,9 @@ char *bus_path_escape(const char *s) {
          * case the empty string. */
 
         if (*s == 0)
-                return strdup("_");
-
-        r = new(char, strlen(s)*3 + 1);
-        if (!r)
-                return NULL;
+                return stpcpy(buf, "_");
 
-        for (f = s, t = r; *f; f++) {
+        for (f = s, t = buf; *f; f++) {
 
                 /* Escape everything that is not a-zA-Z0-9. We also
                  * escape 0-9 if it's the first character */
@@ -1399,6 +1396,20 @@ char *bus_path_escape(const char *s) {
 
         *t = 0;
 
+        return t;
+}
+
+char *bus_path_escape(const char *s) {
+        char *r;
+
+        assert(s);
+
+        r = new(char, BUS_PATH_ESCAPE_MAX(strlen(s)));
+        if (!r)
+                return NULL;
+
+        bus_path_escape_to(r, s);
+
         return r;
 }
 
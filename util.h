@@ -226,6 +226,12 @@ char *cunescape_length_with_prefix(const char *s, size_t length, const char *pre
 char *xescape(const char *s, const char *bad);
 
 char *bus_path_escape(const char *s);
+
+/* Escapes into buf, which needs room for BUS_PATH_ESCAPE_MAX(strlen(s))
+ * bytes, and returns a pointer to the terminating NUL */
+#define BUS_PATH_ESCAPE_MAX(n) ((n) * 3 + 2)
+char *bus_path_escape_to(char *buf, const char *s);
+
 char *bus_path_unescape(const char *s);
 
 char *ascii_strlower(char *path);